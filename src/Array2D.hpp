@@ -76,6 +76,8 @@ public:
 
     void fill() { m_data.set(); }
     void clear() { m_data.reset(); }
+    void merge(const Bitset2D& other) { m_data |= other.m_data; }
+    bool none() const { return m_data.none(); }
 
     void copy(const Bitset2D& other) { m_data = other.m_data; }
     void swap(Bitset2D& other) { std::swap(m_data, other.m_data); }
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <optional>
+
+#include "Commons.hpp"
+
+// Bounded single-producer single-consumer ring, lock-free
+// One thread pushes, one other thread pops; neither ever waits for the other. The producer owns `m_tail`,
+// the consumer owns `m_head`, each only reads the other's with acquire to see the slots it published.
+template <typename T, u32 CAPACITY>
+class CommandQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // producer side, false (and nothing queued) when full
+    bool push(const T& value) {
+        const u32 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        m_slots[tail & (CAPACITY - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    std::optional<T> pop() {
+        const u32 head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        T value = m_slots[head & (CAPACITY - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    // consumer side: everything queued up to now, in order
+    template <typename F>
+    void drain(F&& f) {
+        while (const std::optional<T> value = pop()) {
+            f(*value);
+        }
+    }
+
+private:
+    // apart, so the two threads don't bounce one cache line between them
+    alignas(64) std::atomic<u32> m_head{0};
+    alignas(64) std::atomic<u32> m_tail{0};
+    std::array<T, CAPACITY> m_slots{};
+};
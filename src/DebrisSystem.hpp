@@ -0,0 +1,299 @@
+#pragma once
+
+#include <box2d/box2d.h>
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "SandSimulation.hpp"
+#include "RigidbodyManager.hpp"
+#include "Camera.hpp"
+#include "Commons.hpp"
+#include "TripleBuffer.hpp"
+
+// Grains knocked out of the sand grid, flying until they land back in it
+// Plain ballistic points stored SoA, they collide with the grid itself (stamped rigid bodies included),
+// so there is no Box2D body per grain. A grain hitting rigid body pixels pushes that body instead.
+class DebrisSystem {
+public:
+    // position in meters, velocity in meters per second
+    void spawn(f32 x, f32 y, f32 vx, f32 vy, ParticleID type) {
+        m_x.push_back(x * PIXELS_PER_METER);
+        m_y.push_back(y * PIXELS_PER_METER);
+        m_vx.push_back(vx * PIXELS_PER_METER);
+        m_vy.push_back(vy * PIXELS_PER_METER);
+        m_type.push_back(type);
+        m_age.push_back(0);
+        m_stuck.push_back(0);
+    }
+
+    // cells blown out of the grid all at once (anything with x, y and id), flying away from `center` (pixels)
+    // `speed` in meters per second for the cells right at the center, half of it at the rim
+    template <typename Cells>
+    void eject(const Cells& cells, b2Vec2 center, f32 speed) {
+        const u64 count = size() + cells.size();
+        m_x.reserve(count);
+        m_y.reserve(count);
+        m_vx.reserve(count);
+        m_vy.reserve(count);
+        m_type.reserve(count);
+        m_age.reserve(count);
+        m_stuck.reserve(count);
+
+        f32 reach = 1.0f;
+        for (const auto& c : cells) {
+            reach = std::max(reach, b2Length({c.x + 0.5f - center.x, c.y + 0.5f - center.y}));
+        }
+
+        for (const auto& c : cells) {
+            const b2Vec2 p = {c.x + 0.5f, c.y + 0.5f};
+            const b2Vec2 d = {p.x - center.x, p.y - center.y};
+            const f32 distance = b2Length(d);
+            const b2Vec2 dir = distance > 0.0f ? b2Vec2{d.x / distance, d.y / distance} : b2Vec2{0.0f, -1.0f};
+            // a bit of jitter, or the blast looks like a ring
+            const f32 jitter = 0.75f + 0.5f * static_cast<f32>(fast_rand() & 0xFF) / 255.0f;
+            const f32 s = speed * PIXELS_PER_METER * (1.0f - 0.5f * distance / reach) * jitter;
+
+            m_x.push_back(p.x);
+            m_y.push_back(p.y);
+            m_vx.push_back(dir.x * s);
+            m_vy.push_back(dir.y * s);
+            m_type.push_back(c.id);
+            m_age.push_back(0);
+            m_stuck.push_back(0);
+        }
+    }
+
+    template <u32 W, u32 H>
+    void update(SandWorld<W, H>& world, const RigidbodyManager& bodies, f32 dt) {
+        constexpr f32 GRAVITY = 10.0f * PIXELS_PER_METER; // pixels/s^2, same as the physics world
+        constexpr f32 RESTITUTION = 0.3f;
+        constexpr f32 FRICTION = 0.8f; // tangential speed kept on a bounce
+        constexpr f32 GRAIN_MASS = 1.0f / (PIXELS_PER_METER * PIXELS_PER_METER); // a pixel at the bodies' density
+
+        // TODO: right now, these are physics frames based :/
+        constexpr u16 MAX_AGE = 60 * 7;
+        constexpr u8 MAX_STUCK = 10;
+
+        const i32 w = static_cast<i32>(world.width());
+        const i32 h = static_cast<i32>(world.height());
+        const auto in_grid = [w, h](i32 px, i32 py) { return px >= 0 && px < w && py >= 0 && py < h; };
+
+        u64 i = 0;
+        while (i < size()) {
+            if (++m_age[i] > MAX_AGE) {
+                remove(i);
+                continue;
+            }
+
+            m_vy[i] += GRAVITY * dt;
+
+            f32 x = m_x[i];
+            f32 y = m_y[i];
+            f32 vx = m_vx[i];
+            f32 vy = m_vy[i];
+            const f32 dx = vx * dt;
+            const f32 dy = vy * dt;
+
+            i32 px = static_cast<i32>(std::floor(x));
+            i32 py = static_cast<i32>(std::floor(y));
+            if (!in_grid(px, py)) {
+                remove(i);
+                continue;
+            }
+
+            bool dead = false;
+            bool landed = false;
+
+            if (world.getParticle(px, py).id != ParticleID::AIR) {
+                // spawned inside something (or it filled in around us): drift through it, give up eventually
+                x += dx;
+                y += dy;
+                dead = ++m_stuck[i] > MAX_STUCK;
+            } else {
+                m_stuck[i] = 0;
+
+                // at most one pixel per sub-step, so nothing gets tunneled through
+                const i32 steps = std::max(1, static_cast<i32>(std::ceil(std::max(std::abs(dx), std::abs(dy)))));
+                const f32 sx = dx / steps;
+                const f32 sy = dy / steps;
+
+                for (i32 s = 0; s < steps; ++s) {
+                    const f32 nx = x + sx;
+                    const f32 ny = y + sy;
+                    const i32 cx = static_cast<i32>(std::floor(nx));
+                    const i32 cy = static_cast<i32>(std::floor(ny));
+                    if (!in_grid(cx, cy)) {
+                        dead = true;
+                        break;
+                    }
+
+                    const Particle& hit = world.getParticle(cx, cy);
+                    const BodyID hit_body = world.body_id_at(cx, cy);
+                    if (hit.id == ParticleID::AIR) {
+                        x = nx;
+                        y = ny;
+                        px = cx;
+                        py = cy;
+                        continue;
+                    }
+
+                    if (hit_body != 0) {
+                        push_body(bodies, hit_body, {vx * GRAIN_MASS / PIXELS_PER_METER, vy * GRAIN_MASS / PIXELS_PER_METER},
+                                  {nx / PIXELS_PER_METER, ny / PIXELS_PER_METER});
+                    }
+
+                    // blocked vertically (or both ways): land when falling onto something, bounce off ceilings
+                    if (cy != py && world.getParticle(px, cy).id != ParticleID::AIR) {
+                        if (vy > 0.0f) {
+                            landed = true;
+                        } else {
+                            vy = -vy * RESTITUTION;
+                            vx *= FRICTION;
+                        }
+                    } else {
+                        vx = -vx * RESTITUTION;
+                        vy *= FRICTION;
+                    }
+                    break;
+                }
+            }
+
+            if (landed && px > 0 && px < w - 1 && py > 0 && py < h - 1) {
+                world.set_body_particle(px, py, m_type[i], 0);
+                world.mark_chunk_dirty(px, py);
+                remove(i);
+                continue;
+            }
+            if (dead) {
+                remove(i);
+                continue;
+            }
+
+            m_x[i] = x;
+            m_y[i] = y;
+            m_vx[i] = vx;
+            m_vy[i] = vy;
+            ++i;
+        }
+    }
+
+    // simulation thread, at the end of a step: what render() draws until the next one
+    void publish() {
+        std::vector<Grain>& grains = m_render_list.back();
+        grains.resize(m_x.size());
+        for (u64 i = 0; i < m_x.size(); ++i) {
+            grains[i] = {m_x[i], m_y[i], m_type[i]};
+        }
+        m_render_list.publish();
+    }
+
+    // render debris as colored points (batched for performance)
+    // one reader thread, draws the last published grains without a lock
+    void render(SDL_Renderer* renderer, const Camera& camera) {
+        // reuse buffers to avoid allocation
+        m_batch_sand.clear();
+        m_batch_water.clear();
+        m_batch_stone.clear();
+        m_batch_wood.clear();
+        m_batch_other.clear();
+
+        // size of debris visual (slightly larger than 1px for visibility)
+        const f32 size = 2.5f;
+        const f32 offset = size * 0.5f;
+
+        for (const Grain& g : m_render_list.front()) {
+            const SDL_FPoint p = camera.worldToScreen({g.x / PIXELS_PER_METER, g.y / PIXELS_PER_METER});
+            const SDL_FRect r = {p.x - offset, p.y - offset, size, size};
+
+            switch (g.type) {
+                case ParticleID::SAND:  m_batch_sand.push_back(r); break;
+                case ParticleID::WATER: m_batch_water.push_back(r); break;
+                case ParticleID::STONE: m_batch_stone.push_back(r); break;
+                case ParticleID::WOOD:  m_batch_wood.push_back(r); break;
+                default:                m_batch_other.push_back(r); break;
+            }
+        }
+
+        draw_batch(renderer, m_batch_sand, ParticleID::SAND);
+        draw_batch(renderer, m_batch_water, ParticleID::WATER);
+        draw_batch(renderer, m_batch_stone, ParticleID::STONE);
+        draw_batch(renderer, m_batch_wood, ParticleID::WOOD);
+        if (!m_batch_other.empty()) {
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // White
+            SDL_RenderFillRects(renderer, m_batch_other.data(), static_cast<i32>(m_batch_other.size()));
+        }
+    }
+
+    u64 size() const { return m_x.size(); }
+    bool empty() const { return m_x.empty(); }
+
+    void clear() {
+        m_x.clear();
+        m_y.clear();
+        m_vx.clear();
+        m_vy.clear();
+        m_type.clear();
+        m_age.clear();
+        m_stuck.clear();
+    }
+
+private:
+    struct Grain {
+        f32 x, y; // pixels
+        ParticleID type;
+    };
+
+    // swap with the last grain, order doesn't matter
+    void remove(u64 i) {
+        const u64 last = m_x.size() - 1;
+        m_x[i] = m_x[last];
+        m_y[i] = m_y[last];
+        m_vx[i] = m_vx[last];
+        m_vy[i] = m_vy[last];
+        m_type[i] = m_type[last];
+        m_age[i] = m_age[last];
+        m_stuck[i] = m_stuck[last];
+
+        m_x.pop_back();
+        m_y.pop_back();
+        m_vx.pop_back();
+        m_vy.pop_back();
+        m_type.pop_back();
+        m_age.pop_back();
+        m_stuck.pop_back();
+    }
+
+    static void push_body(const RigidbodyManager& bodies, BodyID id, b2Vec2 impulse, b2Vec2 point) {
+        const RigidbodyManager::BodyInfo* info = bodies.find(id);
+        if (info && b2Body_IsValid(info->body_id)) {
+            b2Body_ApplyLinearImpulse(info->body_id, impulse, point, true);
+        }
+    }
+
+    static void draw_batch(SDL_Renderer* renderer, const std::vector<SDL_FRect>& batch, ParticleID type) {
+        if (batch.empty()) {
+            return;
+        }
+        const auto& c = particle_colors[static_cast<i32>(type)];
+        SDL_SetRenderDrawColorFloat(renderer, c.r, c.g, c.b, c.a);
+        SDL_RenderFillRects(renderer, batch.data(), static_cast<i32>(batch.size()));
+    }
+
+    // pixels and pixels/s
+    std::vector<f32> m_x, m_y;
+    std::vector<f32> m_vx, m_vy;
+    std::vector<ParticleID> m_type;
+    std::vector<u16> m_age;  // in steps, to kill old debris
+    std::vector<u8> m_stuck; // steps spent inside something
+
+    // Render batches
+    std::vector<SDL_FRect> m_batch_sand;
+    std::vector<SDL_FRect> m_batch_water;
+    std::vector<SDL_FRect> m_batch_stone;
+    std::vector<SDL_FRect> m_batch_wood;
+    std::vector<SDL_FRect> m_batch_other;
+
+    TripleBuffer<std::vector<Grain>> m_render_list;
+};
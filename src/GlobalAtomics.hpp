@@ -8,6 +8,14 @@ inline std::atomic<bool> g_sim_running{false};
 inline std::atomic<bool> g_fixed_steps_mode{false};
 inline std::atomic<i32> g_steps_remaining{0};
 inline std::atomic<u32> g_sim_step_count{0};
+inline std::atomic<f32> g_mesh_budget_ms{2.0f};
+inline std::atomic<i32> g_physics_max_substeps{8};
+inline std::atomic<f32> g_physics_budget_ms{4.0f};
+inline std::atomic<f32> g_water_density{1.2f}; // against the bodies' 1, 0 turns buoyancy and drag off
+
+// Camera target (meters), published by the main thread for the simulation thread
+inline std::atomic<f32> g_camera_x{0.0f};
+inline std::atomic<f32> g_camera_y{0.0f};
 
 // Simulation Stats
 inline std::atomic<f32> g_sim_sps{0.0f};
@@ -17,3 +25,7 @@ inline std::atomic<i32> g_stat_mesh_ms{0};
 inline std::atomic<i32> g_stat_update_ms{0};
 inline std::atomic<i32> g_stat_debris_count{0};
 inline std::atomic<i32> g_stat_chains{0};
+inline std::atomic<i32> g_stat_meshed_chunks{0};
+inline std::atomic<i32> g_stat_mesh_deferred{0};
+inline std::atomic<i32> g_stat_physics_steps{0};
+inline std::atomic<i32> g_stat_substeps{0};
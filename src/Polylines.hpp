@@ -0,0 +1,57 @@
+#pragma once
+
+#include <box2d/box2d.h>
+#include <span>
+#include <vector>
+
+#include "Commons.hpp"
+
+// Many polylines packed into one contiguous point array
+// Reused buffers keep their capacity, so meshing every step stops hitting the allocator
+struct Polylines {
+    static constexpr u8 LOOP = 1 << 0; // closed, the last point connects back to the first (which is not repeated)
+
+    std::vector<b2Vec2> points;
+    std::vector<u32> offsets = {0}; // polyline `i` is points[offsets[i], offsets[i + 1])
+    std::vector<u8> flags;
+
+    u64 size() const { return flags.size(); }
+    bool empty() const { return flags.empty(); }
+
+    void clear() {
+        points.clear();
+        offsets.resize(1);
+        offsets[0] = 0;
+        flags.clear();
+    }
+
+    std::span<const b2Vec2> operator[](u64 i) const { return {points.data() + offsets[i], offsets[i + 1] - offsets[i]}; }
+    bool is_loop(u64 i) const { return flags[i] & LOOP; }
+    b2Vec2 front(u64 i) const { return points[offsets[i]]; }
+    b2Vec2 back(u64 i) const { return points[offsets[i + 1] - 1]; }
+
+    // building a polyline in place: push its points, then end it
+    void push_point(b2Vec2 p) { points.push_back(p); }
+    void end_line(u8 line_flags) {
+        offsets.push_back(static_cast<u32>(points.size()));
+        flags.push_back(line_flags);
+    }
+
+    void append(std::span<const b2Vec2> line, u8 line_flags) {
+        points.insert(points.end(), line.begin(), line.end());
+        end_line(line_flags);
+    }
+    void append(const Polylines& other, u64 i) { append(other[i], other.flags[i]); }
+
+    bool operator==(const Polylines& o) const {
+        if (flags != o.flags || offsets != o.offsets) {
+            return false;
+        }
+        for (u64 i = 0; i < points.size(); ++i) {
+            if (points[i].x != o.points[i].x || points[i].y != o.points[i].y) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
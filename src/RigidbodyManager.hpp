@@ -1,11 +1,16 @@
 #pragma once
 
 #include <box2d/box2d.h>
+#include <algorithm>
+#include <array>
 #include <vector>
-#include <unordered_map>
 #include <cmath>
+#include <cstdint>
+#include <utility>
 
 #include "SandSimulation.hpp"
+#include "SlotMap.hpp"
+#include "SpanRaster.hpp"
 #include "Commons.hpp"
 #include "Logging.hpp"
 #include "Camera.hpp"
@@ -13,196 +18,550 @@
 // manages the relationship between Box2D rigidbodies and sand world pixels
 class RigidbodyManager {
 public:
+    // what a body looks like in its own frame, one texel per world pixel
+    // baked once when the body is created and resampled through its transform on every stamp
+    struct BodyImage {
+        i32 width = 0, height = 0;
+        b2Vec2 origin = {0.0f, 0.0f}; // body-local corner of texel (0, 0), in pixels
+        std::vector<ParticleID> texels;
+        ParticleID uniform = ParticleID::AIR; // the one material of the image, AIR when it has several
+
+        // nearest texel at image coordinates (u, v), clamped to the image
+        ParticleID sample(f32 u, f32 v) const {
+            const i32 tu = std::clamp(static_cast<i32>(std::floor(u)), 0, width - 1);
+            const i32 tv = std::clamp(static_cast<i32>(std::floor(v)), 0, height - 1);
+            return texels[tv * width + tu];
+        }
+    };
+
     // info about a rigidbody's pixel representation
     struct BodyInfo {
         b2BodyId body_id;
-        u8 manager_id;     // 1-255, used in Particle::body_id
+        BodyID manager_id; // slot index of the body, what its pixels carry in the world
         f32 width, height; // Size in meters
-        ParticleID material; // FIXME: see below
-        
-        /////////
-        // WIP //
-        /////////
-        // TODO: This assumes a rigidbody is made of the same material which is not always true
-        //       For complex objects, the particles should know their UV inside the body
-
-        // stored pixels when extracted (relative coords + types)
-        struct StoredPixel {
-            i32 rel_x, rel_y; // Relative to body center
-            ParticleID type;
-        };
-        std::vector<StoredPixel> stored_pixels;
+        BodyImage image;
+
+        // local-space shapes, fetched once: bodies never change shape
+        std::vector<b2Polygon> polygons;
+
+        f32 radius = 0.0f; // farthest vertex from the body origin, in meters
+
+        // where the body's pixels currently are in the world, clipped to the grid interior
+        b2Transform stamped_xf = b2Transform_identity;
+        std::vector<Span> stamped_spans;
+        std::vector<Span> next_spans; // footprint being moved to, during restamp()
     };
     
-    u8 register_body(b2BodyId body_id, f32 width, f32 height, ParticleID material) {
-        if (m_next_id == 0) {
-            m_next_id = 1; // 0 is reserved for terrain
-        }
-        const u8 id = m_next_id++;
-        
+    using BodyKey = SlotMap<BodyInfo>::Key;
+
+    // returns 0 when there is no room left for another body
+    // the body has no pixels until one of the bake_* functions gives it an image
+    BodyID register_body(b2BodyId body_id, f32 width, f32 height) {
         BodyInfo info;
         info.body_id = body_id;
-        info.manager_id = id;
         info.width = width;
         info.height = height;
-        info.material = material;
+
+        // bodies are made of polygons only
+        const i32 shape_count = b2Body_GetShapeCount(body_id);
+        std::vector<b2ShapeId> shapes(shape_count);
+        b2Body_GetShapes(body_id, shapes.data(), shape_count);
+        for (b2ShapeId shape : shapes) {
+            if (b2Shape_GetType(shape) == b2_polygonShape) {
+                const b2Polygon polygon = b2Shape_GetPolygon(shape);
+                for (i32 i = 0; i < polygon.count; ++i) {
+                    info.radius = std::max(info.radius, b2Length(polygon.vertices[i]));
+                }
+                info.polygons.push_back(polygon);
+            }
+        }
+        if (info.polygons.empty()) {
+            Logging::log_error("Body has no polygon shapes");
+        }
         
-        m_bodies[id] = info;
-        return id;
+        const BodyKey key = m_bodies.add(std::move(info));
+        if (key.index == 0) {
+            return 0;
+        }
+        m_bodies.get(key)->manager_id = key.index;
+
+        // move events carry the user data, so moved bodies map back to us without a lookup
+        b2Body_SetUserData(body_id, reinterpret_cast<void*>(static_cast<uintptr_t>(key.packed())));
+        return key.index;
+    }
+
+    void unregister_body(BodyID id) {
+        m_bodies.remove(m_bodies.key_at(id));
+    }
+
+    // manager id of a body from its user data, 0 if it isn't ours (anymore)
+    BodyID id_from_user_data(void* user_data) const {
+        const BodyKey key = BodyKey::unpack(static_cast<u32>(reinterpret_cast<uintptr_t>(user_data)));
+        return m_bodies.has(key) ? key.index : 0;
+    }
+
+    BodyInfo* find(BodyID id) { return m_bodies.get(m_bodies.key_at(id)); }
+    const BodyInfo* find(BodyID id) const { return m_bodies.get(m_bodies.key_at(id)); }
+
+    // the body's pixels were put into the world by someone else, at its current transform
+    void mark_stamped(BodyID id, u32 world_width, u32 world_height) {
+        if (BodyInfo* info = find(id)) {
+            info->stamped_xf = b2Body_GetTransform(info->body_id);
+            rasterize_body(*info, info->stamped_xf, world_width, world_height, info->stamped_spans);
+        }
     }
     
-    // helper to iterate pixels inside rotated body
-    template<typename Func>
-    void for_each_pixel_in_body(b2BodyId body_id, Func&& func) {
-        if (!b2Body_IsValid(body_id)) {
-            Logging::log_error("Invalid body");
+    // template bodies: every texel inside the body's shapes is `material`
+    void bake_material(BodyID id, ParticleID material) {
+        BodyInfo* info = find(id);
+        if (!info) {
+            Logging::log_error("Body not found");
             return;
         }
-        
-        const b2Transform xf = b2Body_GetTransform(body_id);
-        
-        // get shapes
-        const i32 shapeCount = b2Body_GetShapeCount(body_id);
-        if (shapeCount == 0) {
-            Logging::log_error("No shapes found");
-            return;
+
+        BodyImage& image = info->image;
+        init_image(*info, b2Body_GetTransform(info->body_id));
+
+        m_bake_spans.clear();
+        for (const b2Polygon& polygon : info->polygons) {
+            for (i32 i = 0; i < polygon.count; ++i) {
+                m_vertices[i] = b2Sub(b2MulSV(PIXELS_PER_METER, polygon.vertices[i]), image.origin);
+            }
+            rasterize_convex({m_vertices.data(), static_cast<u64>(polygon.count)}, m_bake_spans);
         }
-        std::vector<b2ShapeId> shapes(shapeCount);
-        b2Body_GetShapes(body_id, shapes.data(), shapeCount);
-        
-        // compute rotated AABB union
-        b2AABB aabb = b2Shape_GetAABB(shapes[0]); // world space AABB
-        for(i32 i = 1; i < shapeCount; ++i) {
-            const b2AABB s_aabb = b2Shape_GetAABB(shapes[i]);
-            aabb.lowerBound = b2Min(aabb.lowerBound, s_aabb.lowerBound);
-            aabb.upperBound = b2Max(aabb.upperBound, s_aabb.upperBound);
+        clip_spans(m_bake_spans, 0, 0, image.width, image.height);
+        for (const Span& s : m_bake_spans) {
+            std::fill_n(image.texels.begin() + s.y * image.width + s.x0, s.x1 - s.x0, material);
         }
-        
-        // expand slightly for safety (rasterization coverage)
-        const i32 min_x = static_cast<i32>(std::floor(aabb.lowerBound.x * PIXELS_PER_METER));
-        const i32 max_x = static_cast<i32>(std::ceil(aabb.upperBound.x * PIXELS_PER_METER));
-        const i32 min_y = static_cast<i32>(std::floor(aabb.lowerBound.y * PIXELS_PER_METER));
-        const i32 max_y = static_cast<i32>(std::ceil(aabb.upperBound.y * PIXELS_PER_METER));
-        
-        // iterate AABB
-        for (i32 py = min_y; py <= max_y; ++py) {
-            for (i32 px = min_x; px <= max_x; ++px) {
-                // check center of pixel
-                const b2Vec2 world_pos = { (px + 0.5f) / PIXELS_PER_METER, (py + 0.5f) / PIXELS_PER_METER };
-                const b2Vec2 local_pos = b2InvTransformPoint(xf, world_pos);
-
-                bool inside = false;
-                // check all shapes
-                for (b2ShapeId shapeId : shapes) {
-                    if (b2Shape_TestPoint(shapeId, world_pos)) {
-                        inside = true;
-                        break;
-                    }
-                }
-                
-                if (inside) {
-                    func(px, py, local_pos); // pass local_pos if needed for texture mapping
+
+        image.uniform = material;
+        pad_image(image);
+    }
+
+    // bodies cut out of terrain: captures the world pixels the body owns at its current transform
+    template<u32 W, u32 H>
+    void bake_from_world(BodyID id, const SandWorld<W, H>& world) {
+        BodyInfo* info = find(id);
+        if (!info) {
+            Logging::log_error("Body not found");
+            return;
+        }
+
+        BodyImage& image = info->image;
+        const b2Transform xf = b2Body_GetTransform(info->body_id);
+        init_image(*info, xf);
+
+        bool first = true;
+        bool uniform = true;
+        for (i32 v = 0; v < image.height; ++v) {
+            for (i32 u = 0; u < image.width; ++u) {
+                const b2Vec2 local = {(image.origin.x + u + 0.5f) / PIXELS_PER_METER, (image.origin.y + v + 0.5f) / PIXELS_PER_METER};
+                const b2Vec2 p = b2MulSV(PIXELS_PER_METER, b2TransformPoint(xf, local));
+                const i32 px = static_cast<i32>(std::floor(p.x));
+                const i32 py = static_cast<i32>(std::floor(p.y));
+                if (px < 0 || py < 0 || px >= static_cast<i32>(world.width()) || py >= static_cast<i32>(world.height()) ||
+                    world.body_id_at(px, py) != id) {
+                    continue;
                 }
+
+                const ParticleID material = world.getParticle(px, py).id;
+                image.texels[v * image.width + u] = material;
+                uniform = uniform && (first || material == image.uniform);
+                image.uniform = material;
+                first = false;
             }
         }
+
+        if (!uniform) {
+            image.uniform = ParticleID::AIR;
+        }
+        pad_image(image);
     }
 
     // extract body pixels from world
-    // stores the pixels and clears them from world
+    // clears the spans they were last stamped into
     template<u32 W, u32 H>
-    void extract_body_pixels(u8 id, SandWorld<W, H>& world) {
-        const auto it = m_bodies.find(id);
-        if (it == m_bodies.end()) {
+    void extract_body_pixels(BodyID id, SandWorld<W, H>& world) {
+        BodyInfo* found = find(id);
+        if (!found) {
             Logging::log_error("Body not found");
             return;
         }
-        
-        const BodyInfo& info = it->second;
-        if (!b2Body_IsValid(info.body_id)) {
-            Logging::log_error("Invalid body");
+
+        BodyInfo& info = *found;
+        for (const Span& s : info.stamped_spans) {
+            for (i32 px = s.x0; px < s.x1; ++px) {
+                if (world.body_id_at(px, s.y) == id) {
+                    world.set_body_particle(px, s.y, ParticleID::AIR, 0);
+                }
+            }
+        }
+        info.stamped_spans.clear();
+    }
+    
+    // a terrain pixel a body was stamped over
+    struct Displaced {
+        i32 x, y;
+        ParticleID type;
+        BodyID body;
+    };
+
+    // moves the pixels of bodies that moved since they were last stamped, spread over the world's pool
+    // bodies whose footprints (old and new) share a chunk form a group that one task handles in order, so no two
+    // tasks ever touch the same pixels. Within a group every body clears the pixels it left before any writes
+    // its new ones, so bodies moving into each other's old spot don't clash.
+    // drops from `ids` the bodies that moved too little to re-stamp, appends the terrain the others displaced
+    template<u32 W, u32 H>
+    void restamp(std::vector<BodyID>& ids, SandWorld<W, H>& world, std::vector<Displaced>& displaced) {
+        std::erase_if(ids, [&](BodyID id) { return !prepare_restamp(id, world.width(), world.height()); });
+        if (ids.empty()) {
             return;
         }
-        
-        for_each_pixel_in_body(info.body_id, [&](i32 px, i32 py, b2Vec2 local) {
-            if (px > 0 && px < static_cast<i32>(world.width()) - 1 &&
-                py > 0 && py < static_cast<i32>(world.height()) - 1) {
-                
-                Particle& p = world.getParticleMut(px, py);
-                if (p.body_id == id) {
-                    p.id = ParticleID::AIR;
-                    p.body_id = 0;
+
+        // union the chunks each body touches
+        m_chunk_parent.resize(world.chunk_count());
+        for (u32 i = 0; i < world.chunk_count(); ++i) {
+            m_chunk_parent[i] = i;
+        }
+        m_order.clear();
+        for (const BodyID id : ids) {
+            const BodyInfo& info = *find(id);
+            i32 x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+            for (const std::vector<Span>* spans : {&info.stamped_spans, &info.next_spans}) {
+                for (const Span& s : *spans) {
+                    x0 = std::min(x0, s.x0);
+                    x1 = std::max(x1, s.x1 - 1);
+                    y0 = std::min(y0, s.y);
+                    y1 = std::max(y1, s.y);
                 }
             }
-        });
+            if (x0 > x1) {
+                m_order.push_back({0, id}); // off the grid entirely, nothing to write
+                continue;
+            }
+
+            const u32 first = world.chunk_index(x0 / world.chunk_width(), y0 / world.chunk_height());
+            for (u32 cy = y0 / world.chunk_height(); cy <= y1 / world.chunk_height(); ++cy) {
+                for (u32 cx = x0 / world.chunk_width(); cx <= x1 / world.chunk_width(); ++cx) {
+                    const u32 a = find_chunk_root(first);
+                    const u32 b = find_chunk_root(world.chunk_index(cx, cy));
+                    m_chunk_parent[std::max(a, b)] = std::min(a, b);
+                }
+            }
+            m_order.push_back({first, id});
+        }
+        for (auto& [root, id] : m_order) {
+            root = find_chunk_root(root);
+        }
+        std::sort(m_order.begin(), m_order.end());
+
+        // groups as ranges of `m_order`, weighted by the pixels they cover
+        m_groups.clear();
+        for (u64 i = 0; i < m_order.size(); ++i) {
+            if (i == 0 || m_order[i].first != m_order[i - 1].first) {
+                m_groups.push_back({i, i, 0});
+            }
+            Group& group = m_groups.back();
+            group.end = i + 1;
+            for (const Span& s : find(m_order[i].second)->next_spans) {
+                group.pixels += s.x1 - s.x0;
+            }
+        }
+
+        // heaviest groups first, each to the least loaded task
+        ThreadPool& pool = world.thread_pool();
+        const u64 tasks = std::min<u64>(std::max<u64>(pool.thread_count(), 1), m_groups.size());
+        std::sort(m_groups.begin(), m_groups.end(), [](const Group& a, const Group& b) { return a.pixels > b.pixels; });
+        m_scratch.resize(std::max<u64>(m_scratch.size(), tasks));
+        m_task_groups.resize(std::max<u64>(m_task_groups.size(), tasks));
+        std::vector<u64> load(tasks, 0);
+        for (u64 t = 0; t < tasks; ++t) {
+            m_task_groups[t].clear();
+            m_scratch[t].displaced.clear();
+            m_scratch[t].unanchored.clear();
+        }
+        for (const Group& group : m_groups) {
+            const u64 t = std::min_element(load.begin(), load.end()) - load.begin();
+            m_task_groups[t].push_back(group);
+            load[t] += group.pixels;
+        }
+
+        const auto run = [this, &world](u64 t) {
+            StampScratch& scratch = m_scratch[t];
+            for (const Group& group : m_task_groups[t]) {
+                for (u64 i = group.begin; i < group.end; ++i) {
+                    clear_left_pixels(m_order[i].second, world, scratch);
+                }
+                for (u64 i = group.begin; i < group.end; ++i) {
+                    stamp_new_pixels(m_order[i].second, world, scratch);
+                }
+            }
+        };
+        if (tasks == 1) {
+            run(0);
+        } else {
+            for (u64 t = 0; t < tasks; ++t) {
+                pool.enqueue([&run, t] { run(t); });
+            }
+            pool.wait_all();
+        }
+
+        // chunk and island bookkeeping isn't safe to share, it happens here
+        for (u64 t = 0; t < tasks; ++t) {
+            for (const Displaced& d : m_scratch[t].displaced) {
+                world.mark_chunk_dirty(d.x, d.y); // terrain under the body changed
+            }
+            for (const auto& [x, y] : m_scratch[t].unanchored) {
+                world.mark_island_dirty(x, y);
+            }
+            displaced.insert(displaced.end(), m_scratch[t].displaced.begin(), m_scratch[t].displaced.end());
+        }
     }
     
-    // restore body pixels after physics step
-    // returns list of displaced sand pixels that need to become debris
+    void clear() {
+        m_bodies.clear();
+    }
+    
+    // every registered body, packed
+    const std::vector<BodyInfo>& bodies() const { return m_bodies.all(); }
+    
+    // buoyancy and drag over the next `dt` seconds on every body whose stamped footprint touches liquid
+    // the submerged area is estimated as the footprint rows with liquid right next to either end,
+    // the liquid itself was pushed out of the footprint when the body was stamped
     template<u32 W, u32 H>
-    std::vector<std::tuple<i32, i32, ParticleID>> restore_body_pixels(u8 id, SandWorld<W, H>& world) {
-        std::vector<std::tuple<i32, i32, ParticleID>> displaced;
-        
-        const auto it = m_bodies.find(id);
-        if (it == m_bodies.end()) {
+    void apply_fluid_forces(const SandWorld<W, H>& world, f32 density, f32 dt) {
+        constexpr f32 GRAVITY = 10.0f; // same as the physics world
+        constexpr f32 DRAG = 4.0f;     // per unit of submerged area and liquid density
+
+        if (density <= 0.0f) {
+            return;
+        }
+
+        const auto wet = [&world](i32 x, i32 y) {
+            return world.is_liquid(world.getParticle(x, y).id) && world.body_id_at(x, y) == 0;
+        };
+
+        for (const BodyInfo& info : m_bodies.all()) {
+            if (!b2Body_IsValid(info.body_id)) {
+                continue;
+            }
+
+            // spans are clipped to the grid interior, their neighbours are always in the grid
+            f32 pixels = 0.0f;
+            b2Vec2 center = {0.0f, 0.0f};
+            for (const Span& s : info.stamped_spans) {
+                if (wet(s.x0 - 1, s.y) || wet(s.x1, s.y)) {
+                    const f32 n = static_cast<f32>(s.x1 - s.x0);
+                    pixels += n;
+                    center.x += n * (s.x0 + s.x1) * 0.5f;
+                    center.y += n * (s.y + 0.5f);
+                }
+            }
+            if (pixels == 0.0f) {
+                continue;
+            }
+
+            // pushed up at the center of the submerged part, so bodies also right themselves
+            const f32 area = pixels / (PIXELS_PER_METER * PIXELS_PER_METER);
+            const b2Vec2 velocity = b2Body_GetLinearVelocity(info.body_id);
+            const b2Vec2 impulse = {-DRAG * density * area * velocity.x * dt,
+                                    (-density * GRAVITY * area - DRAG * density * area * velocity.y) * dt};
+            const b2Vec2 point = {center.x / (pixels * PIXELS_PER_METER), center.y / (pixels * PIXELS_PER_METER)};
+            b2Body_ApplyLinearImpulse(info.body_id, impulse, point, true);
+        }
+    }
+
+private:
+    struct StampScratch {
+        std::vector<Span> diff;
+        std::vector<Displaced> displaced;
+        std::vector<std::pair<i32, i32>> unanchored; // pixels that stopped anchoring
+    };
+
+    // bodies `m_order[begin, end)`, covering `pixels`
+    struct Group {
+        u64 begin, end;
+        u64 pixels;
+    };
+
+    u32 find_chunk_root(u32 i) {
+        while (m_chunk_parent[i] != i) {
+            m_chunk_parent[i] = m_chunk_parent[m_chunk_parent[i]];
+            i = m_chunk_parent[i];
+        }
+        return i;
+    }
+
+    // works out where a moved body's pixels go, false when it moved less than RESTAMP_THRESHOLD px
+    // since it was last stamped: its pixels then stay as they are
+    bool prepare_restamp(BodyID id, u32 world_width, u32 world_height) {
+        BodyInfo* info = find(id);
+        if (!info) {
             Logging::log_error("Body not found");
-            return displaced;
+            return false;
         }
-        
-        const BodyInfo& info = it->second;
-        if (!b2Body_IsValid(info.body_id)) {
+        if (!b2Body_IsValid(info->body_id)) {
             Logging::log_error("Invalid body");
-            return displaced;
+            return false;
         }
-        
-        for_each_pixel_in_body(info.body_id, [&](i32 px, i32 py, b2Vec2 local) {
-            if (px > 0 && px < static_cast<i32>(world.width()) - 1 &&
-                py > 0 && py < static_cast<i32>(world.height()) - 1) {
-                
-                Particle& p = world.getParticleMut(px, py);
-                if (p.body_id == 0 && p.id != ParticleID::AIR) {
-                    displaced.push_back({px, py, p.id});
-                }
-                
-                // stamp pixel
-                // here we use the body's material (uniform)
-                // TODO: see top of file
-                p.id = info.material;
-                p.body_id = id;
-            }
-        });
-        
-        return displaced;
+
+        const b2Transform xf = b2Body_GetTransform(info->body_id);
+        if (!info->stamped_spans.empty() && !moved_enough(*info, xf)) {
+            return false;
+        }
+        info->stamped_xf = xf;
+        rasterize_body(*info, xf, world_width, world_height, info->next_spans);
+        return true;
     }
-    
-    // extract ALL registered bodies
+
+    // clears the pixels the body's old footprint has and its new one lacks
     template<u32 W, u32 H>
-    void extract_all(SandWorld<W, H>& world) {
-        for (auto& [id, info] : m_bodies) {
-            extract_body_pixels(id, world);
+    void clear_left_pixels(BodyID id, SandWorld<W, H>& world, StampScratch& scratch) {
+        const BodyInfo& info = *find(id);
+        scratch.diff.clear();
+        subtract_spans(info.stamped_spans, info.next_spans, scratch.diff);
+        for (const Span& s : scratch.diff) {
+            for (i32 px = s.x0; px < s.x1; ++px) {
+                if (world.body_id_at(px, s.y) == id) {
+                    world.set_body_particle_concurrent(px, s.y, ParticleID::AIR, 0); // body pixels never anchor, nothing to report
+                }
+            }
         }
     }
-    
-    // restore ALL registered bodies, collect all displaced
+
+    // writes the body's image at its new footprint
+    // a single-material body only writes the pixels it didn't already cover, others resample their whole footprint
+    // but still only write the pixels whose texel changed
     template<u32 W, u32 H>
-    std::vector<std::tuple<i32, i32, ParticleID>> restore_all(SandWorld<W, H>& world) {
-        std::vector<std::tuple<i32, i32, ParticleID>> all_displaced;
-        
-        for (auto& [id, info] : m_bodies) {
-            const auto displaced = restore_body_pixels(id, world);
-            all_displaced.insert(all_displaced.end(), displaced.begin(), displaced.end());
+    void stamp_new_pixels(BodyID id, SandWorld<W, H>& world, StampScratch& scratch) {
+        BodyInfo& info = *find(id);
+        const BodyImage& image = info.image;
+        const std::vector<Span>* spans = &info.next_spans;
+        if (image.uniform != ParticleID::AIR) {
+            scratch.diff.clear();
+            subtract_spans(info.next_spans, info.stamped_spans, scratch.diff);
+            spans = &scratch.diff;
         }
-        
-        return all_displaced;
+
+        // image coordinates step by the inverse rotation along a row
+        const b2Rot q = info.stamped_xf.q;
+        const b2Vec2 step = {q.c, -q.s};
+
+        for (const Span& s : *spans) {
+            const b2Vec2 start = {(s.x0 + 0.5f) / PIXELS_PER_METER, (s.y + 0.5f) / PIXELS_PER_METER};
+            b2Vec2 uv = b2Sub(b2MulSV(PIXELS_PER_METER, b2InvTransformPoint(info.stamped_xf, start)), image.origin);
+
+            for (i32 px = s.x0; px < s.x1; ++px, uv.x += step.x, uv.y += step.y) {
+                const ParticleID material = image.uniform != ParticleID::AIR ? image.uniform : image.sample(uv.x, uv.y);
+                if (material == ParticleID::AIR) {
+                    continue; // hole in the image
+                }
+
+                const Particle& p = world.getParticle(px, s.y);
+                const BodyID owner = world.body_id_at(px, s.y);
+                if (owner == id && p.id == material) {
+                    continue;
+                }
+                if (owner == 0 && p.id != ParticleID::AIR) {
+                    scratch.displaced.push_back({px, s.y, p.id, id});
+                }
+                if (world.set_body_particle_concurrent(px, s.y, material, id)) {
+                    scratch.unanchored.push_back({px, s.y});
+                }
+            }
+        }
+        std::swap(info.stamped_spans, info.next_spans);
+        info.next_spans.clear();
     }
-    
-    void clear() {
-        m_bodies.clear();
-        m_next_id = 1;
+
+    // how far a pixel of the body can have travelled since it was stamped
+    static bool moved_enough(const BodyInfo& info, const b2Transform& xf) {
+        const f32 shift = b2Length(b2Sub(xf.p, info.stamped_xf.p));
+        const f32 turn = std::abs(b2RelativeAngle(info.stamped_xf.q, xf.q)) * info.radius;
+        return (shift + turn) * PIXELS_PER_METER >= RESTAMP_THRESHOLD;
     }
-    
-    const std::unordered_map<u8, BodyInfo>& get_bodies() const { return m_bodies; }
-    
-private:
-    std::unordered_map<u8, BodyInfo> m_bodies;
-    u8 m_next_id = 1;
+
+    // the body's polygons placed at `xf`, as normalized pixel spans
+    // pixels on the world border are never stamped
+    void rasterize_body(const BodyInfo& info, const b2Transform& xf, u32 world_width, u32 world_height, std::vector<Span>& spans) {
+        spans.clear();
+        for (const b2Polygon& polygon : info.polygons) {
+            for (i32 i = 0; i < polygon.count; ++i) {
+                m_vertices[i] = b2MulSV(PIXELS_PER_METER, b2TransformPoint(xf, polygon.vertices[i]));
+            }
+            rasterize_convex({m_vertices.data(), static_cast<u64>(polygon.count)}, spans);
+        }
+        clip_spans(spans, 1, 1, static_cast<i32>(world_width) - 1, static_cast<i32>(world_height) - 1);
+        normalize_spans(spans);
+    }
+
+    // sizes the image to the body's shapes, plus a one texel ring for pad_image
+    // texel centers land on pixel centers at `xf` when it isn't rotated, so a bake from the world reads each pixel once
+    static void init_image(BodyInfo& info, const b2Transform& xf) {
+        b2Vec2 lo = {INFINITY, INFINITY};
+        b2Vec2 hi = {-INFINITY, -INFINITY};
+        for (const b2Polygon& polygon : info.polygons) {
+            for (i32 i = 0; i < polygon.count; ++i) {
+                lo = b2Min(lo, polygon.vertices[i]);
+                hi = b2Max(hi, polygon.vertices[i]);
+            }
+        }
+
+        BodyImage& image = info.image;
+        image.texels.clear();
+        image.uniform = ParticleID::AIR;
+        if (info.polygons.empty()) {
+            image.width = image.height = 0;
+            return;
+        }
+
+        const b2Vec2 pos = b2MulSV(PIXELS_PER_METER, xf.p);
+        lo = b2MulSV(PIXELS_PER_METER, lo);
+        hi = b2MulSV(PIXELS_PER_METER, hi);
+        image.origin = {std::floor(lo.x + pos.x) - pos.x - 1.0f, std::floor(lo.y + pos.y) - pos.y - 1.0f};
+        image.width = static_cast<i32>(std::ceil(hi.x - image.origin.x)) + 1;
+        image.height = static_cast<i32>(std::ceil(hi.y - image.origin.y)) + 1;
+        image.texels.assign(image.width * image.height, ParticleID::AIR);
+    }
+
+    // grows the material one texel into empty neighbours, so nearest lookups along
+    // the rotated edges of the footprint don't fall just outside the baked pixels
+    void pad_image(BodyImage& image) {
+        m_padded.assign(image.texels.begin(), image.texels.end());
+        for (i32 v = 0; v < image.height; ++v) {
+            for (i32 u = 0; u < image.width; ++u) {
+                ParticleID& texel = m_padded[v * image.width + u];
+                if (texel != ParticleID::AIR) {
+                    continue;
+                }
+                if (u > 0 && image.texels[v * image.width + u - 1] != ParticleID::AIR) {
+                    texel = image.texels[v * image.width + u - 1];
+                } else if (u + 1 < image.width && image.texels[v * image.width + u + 1] != ParticleID::AIR) {
+                    texel = image.texels[v * image.width + u + 1];
+                } else if (v > 0 && image.texels[(v - 1) * image.width + u] != ParticleID::AIR) {
+                    texel = image.texels[(v - 1) * image.width + u];
+                } else if (v + 1 < image.height && image.texels[(v + 1) * image.width + u] != ParticleID::AIR) {
+                    texel = image.texels[(v + 1) * image.width + u];
+                }
+            }
+        }
+        image.texels.swap(m_padded);
+    }
+
+    // in pixels, smaller moves leave a body's pixels where they are until they add up
+    static constexpr f32 RESTAMP_THRESHOLD = 0.25f;
+
+    SlotMap<BodyInfo> m_bodies;
+
+    // rasterization scratch, in pixels
+    std::array<b2Vec2, B2_MAX_POLYGON_VERTICES> m_vertices;
+    std::vector<Span> m_bake_spans;
+    std::vector<ParticleID> m_padded;
+
+    // restamp() state, kept for the capacity
+    std::vector<u32> m_chunk_parent;
+    std::vector<std::pair<u32, BodyID>> m_order; // group root chunk, body
+    std::vector<Group> m_groups;
+    std::vector<std::vector<Group>> m_task_groups;
+    std::vector<StampScratch> m_scratch; // one per task
 };
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <mutex>
 #include <thread>
+#include <variant>
 
 #include "./Commons.hpp"
 #include "./App.hpp"
@@ -14,11 +15,32 @@
 #include "./SandSimulation.hpp"
 #include "./PhysicsWorld.hpp"
 #include "./RigidbodyManager.hpp"
+#include "./DebrisSystem.hpp"
+#include "./CommandQueue.hpp"
 #include "imgui.h"
 #include "GlobalAtomics.hpp"
 
 static const char* particle_names[] = { "AIR", "STONE", "SAND", "WATER" };
 
+static constexpr f32 PHYSICS_DT = 1.0f / 60.0f;
+static constexpr i32 MAX_PHYSICS_STEPS = 4; // per sand step, past that physics slows down instead of spiralling
+
+// input, queued by the main thread and applied by the simulation thread at the top of its next step
+struct PaintStroke {
+    b2Vec2 from, to; // pixels
+    f32 radius;      // pixels
+    ParticleID particle;
+};
+struct SpawnBox {
+    b2Vec2 position; // meters
+};
+struct Explode {
+    b2Vec2 center; // pixels
+    f32 radius;    // pixels
+};
+struct ResetWorld {};
+using InputCommand = std::variant<PaintStroke, SpawnBox, Explode, ResetWorld>;
+
 inline void ImGui__SliderU32(const char* label, u32* v, u32 v_min, u32 v_max) {
     ImGui::SliderScalar(label, ImGuiDataType_U32, v, &v_min, &v_max);
 }
@@ -39,7 +61,9 @@ public:
         ImGui::Separator();
         
         ImGui::Text("RBs:%d |SMCs:%d |DPs:%d", g_rigidbody_count.load(), g_static_mesh_count.load(), g_stat_debris_count.load());
-        ImGui::Text("Timings(ms): Mesh Gen:%d |Phys Update:%d", g_stat_mesh_ms.load(), g_stat_update_ms.load());
+        ImGui::Text("Timings(ms): Mesh Wait:%d |Phys Update:%d", g_stat_mesh_ms.load(), g_stat_update_ms.load());
+        ImGui::Text("Meshed chunks:%d |Deferred:%d |Chains:%d", g_stat_meshed_chunks.load(), g_stat_mesh_deferred.load(), g_stat_chains.load());
+        ImGui::Text("Physics steps:%d |Substeps:%d", g_stat_physics_steps.load(), g_stat_substeps.load());
         ImGui::Separator();
 
         ImGui::SliderInt("Brush size", &m_brush_size, 1, 50);
@@ -66,6 +90,28 @@ public:
         ImGui__SliderU32("Max distance", &WATER_MAX_DIST, 1, 10);
         ImGui__SliderU32("Falloff factor", &WATER_SPREAD_FALLOFF, 1, 10);
         ImGui::Separator();
+
+        ImGui::Text("Physics");
+        i32 max_substeps = g_physics_max_substeps.load();
+        if (ImGui::SliderInt("Max substeps", &max_substeps, 1, 16)) {
+            g_physics_max_substeps.store(max_substeps);
+        }
+        f32 physics_budget = g_physics_budget_ms.load();
+        if (ImGui::SliderFloat("Physics budget (ms)", &physics_budget, 0.5f, 16.0f)) {
+            g_physics_budget_ms.store(physics_budget);
+        }
+        f32 water_density = g_water_density.load();
+        if (ImGui::SliderFloat("Water density", &water_density, 0.0f, 3.0f)) {
+            g_water_density.store(water_density);
+        }
+        ImGui::Separator();
+
+        ImGui::Text("Terrain Meshing");
+        f32 mesh_budget = g_mesh_budget_ms.load();
+        if (ImGui::SliderFloat("Budget (ms)", &mesh_budget, 0.0f, 16.0f)) {
+            g_mesh_budget_ms.store(mesh_budget);
+        }
+        ImGui::Separator();
         
         ImGui::End();
         
@@ -126,14 +172,13 @@ public:
         
         // TODO: FIXME: this is actually more than just debug rendering :/
         m_main_scene.m_debug_render_cb = [this](SDL_Renderer* renderer) {
-            // lock to prevent flickering
-            std::lock_guard<std::mutex> lock(m_physics_mutex);
-
             // TEMP: FIXME: this is NOT debug rendering
-            // draw debris
-            m_physics_world->render_debris(renderer, m_main_scene.m_camera);
+            // draw debris, as of the last published step
+            m_debris.render(renderer, m_main_scene.m_camera);
 
+            // Box2D is read directly, only this waits for the simulation
             if (m_debug_draw) {
+                std::lock_guard<std::mutex> lock(m_physics_mutex);
                 m_physics_world->render_debug(renderer, m_main_scene.m_camera);
             }
         };
@@ -149,6 +194,7 @@ public:
     void simulation_thread_proc() {
         u64 last_step_count = g_sim_step_count.load();
         auto last_sps_update = std::chrono::steady_clock::now();
+        auto last_physics_time = std::chrono::steady_clock::now();
 
         while (g_sim_running.load(std::memory_order_acquire)) {
             if (g_fixed_steps_mode.load(std::memory_order_acquire)) { // fixed step mode
@@ -169,6 +215,9 @@ public:
                 }
             }
 
+            // edits land here, before anything of this step looks at the grid
+            apply_input();
+
             if (m_benchmark_mode) {
                 run_benchmark_iteration();
             }
@@ -177,82 +226,123 @@ public:
             // displacement & physics //
             ////////////////////////////
 
-            // static terrain mesh generation
-            const auto start_mesh = std::chrono::high_resolution_clock::now();
-            const auto chains = m_sand_world.mesh_world_parallel();
-            const auto end_mesh = std::chrono::high_resolution_clock::now();
+            // physics runs on real time through an accumulator, however fast sand steps
+            // stepping by hand (or benchmarking) keeps them in lockstep instead
+            const auto physics_time = std::chrono::steady_clock::now();
+            if (g_fixed_steps_mode.load(std::memory_order_acquire) || m_benchmark_mode) {
+                m_physics_accumulator += PHYSICS_DT;
+            } else {
+                m_physics_accumulator += std::chrono::duration<f32>(physics_time - last_physics_time).count();
+            }
+            last_physics_time = physics_time;
+            m_physics_accumulator = std::min(m_physics_accumulator, MAX_PHYSICS_STEPS * PHYSICS_DT);
+            const i32 physics_steps = static_cast<i32>(m_physics_accumulator / PHYSICS_DT);
+            m_physics_accumulator -= physics_steps * PHYSICS_DT;
+
+            // static terrain mesh generation, only where something can collide this step
+            // meshes the snapshot captured at the end of the previous step while the sand step runs
+            {
+                std::lock_guard<std::mutex> lock(m_physics_mutex);
+                m_physics_world->collision_regions(std::max(physics_steps, 1) * PHYSICS_DT, m_collision_regions, m_awake_regions);
+            }
+            // no bodies: pure sand/water play doesn't pay for terrain collision
+            const bool meshing = !m_collision_regions.empty();
+            if (meshing) {
+                const b2Vec2 camera = {g_camera_x.load(std::memory_order_relaxed), g_camera_y.load(std::memory_order_relaxed)};
+                m_sand_world.begin_meshing(m_collision_regions, m_awake_regions, camera, g_mesh_budget_ms.load(std::memory_order_relaxed));
+            }
             
             // step sand simulation
             m_sand_world.update();
 
+            // only the part of meshing that didn't fit under the sand step shows up here
+            const auto start_mesh = std::chrono::high_resolution_clock::now();
+            std::vector<std::pair<u32, u32>> changed_chunks;
+            if (meshing) {
+                changed_chunks = m_sand_world.finish_meshing();
+            }
+            const auto end_mesh = std::chrono::high_resolution_clock::now();
+
             {
                 std::lock_guard<std::mutex> lock(m_physics_mutex);
 
-                // extract rigidbody pixels (remove from world)
-                m_rigidbody_manager.extract_all(m_sand_world);
-                
-                // update static terrain mesh for physics
+                // update static terrain mesh for physics (only chunks whose chains changed)
                 const auto start_update = std::chrono::high_resolution_clock::now();
-                m_physics_world->update_terrain_mesh(chains);
+                for (const auto& [cx, cy] : changed_chunks) {
+                    m_physics_world->update_terrain_chunk(m_sand_world.chunk_index(cx, cy), m_sand_world.m_chunk_cache(cx, cy).merged);
+                }
                 const auto end_update = std::chrono::high_resolution_clock::now();
                 
                 // update counters
                 g_rigidbody_count.store(static_cast<i32>(m_physics_world->get_dynamic_body_count()), std::memory_order_release);
                 g_static_mesh_count.store(m_physics_world->get_terrain_shape_count(), std::memory_order_release);
                 
-                // step physics (FIXED STEP)
-                // TODO: see if varying step might be better?
-                m_physics_world->step(1.0f / 60.0f);
-                
-                const u64 debris_count = m_physics_world->debris_count();
-                
-                // restore rigidbody pixels & handle displacement
-                // manual iteration to get body info for "top ejection"
-                for (const auto& [id, info] : m_rigidbody_manager.get_bodies()) {
-                    if (!b2Body_IsValid(info.body_id)) {
-                        continue;
-                    }
-                    
-                    // restore pixels for this body
-                    const auto displaced = m_rigidbody_manager.restore_body_pixels(id, m_sand_world);
-                    
-                    // Calculate spawn height
-                    const b2Transform xf = b2Body_GetTransform(info.body_id);
-                    const f32 hx = info.width * 0.5f;
-                    const f32 hy = info.height * 0.5f;
-                    const b2Vec2 corners[4] = {{-hx, -hy}, {hx, -hy}, {hx, hy}, {-hx, hy}};
-
-                    f32 min_y = 1e9f;
-                    for(i32 i = 0; i < 4; ++i) {
-                        const b2Vec2 v = b2TransformPoint(xf, corners[i]);
-                        if(v.y < min_y) {
-                            min_y = v.y;
+                // fixed physics steps, as many as real time asks for
+                // only bodies that moved during any of them get re-stamped, sleeping and resting ones keep their pixels
+                m_moved_bodies.clear();
+                const i32 substeps = physics_steps > 0 ? choose_substeps(physics_steps) : 0;
+                const auto start_physics = std::chrono::steady_clock::now();
+                const f32 water_density = g_water_density.load(std::memory_order_relaxed);
+                for (i32 step = 0; step < physics_steps; ++step) {
+                    // every body in liquid, every step: resting ones keep their old footprint but still float
+                    m_rigidbody_manager.apply_fluid_forces(m_sand_world, water_density, PHYSICS_DT);
+                    m_physics_world->step(PHYSICS_DT, substeps);
+
+                    const b2BodyEvents events = b2World_GetBodyEvents(m_physics_world->get_world_id());
+                    for (i32 i = 0; i < events.moveCount; ++i) {
+                        const BodyID id = m_rigidbody_manager.id_from_user_data(events.moveEvents[i].userData);
+                        if (id != 0) {
+                            m_moved_bodies.push_back(id);
                         }
                     }
-
-                    const f32 top_y = min_y - (2.0f / PIXELS_PER_METER);
-                    
-                    // create debris for displaced particles
-                    for (const auto& [px, py, type] : displaced) {
-                        f32 vx = (fast_rand() % 100 - 50) / 25.0f; // soft spread (+/- 2.0)
-                        f32 vy = -1.0f - (fast_rand() % 50) / 25.0f; // soft upward pop (-1.0 to -3.0)
-                        
-                        // spawn at pixel's X, but Body's Top Y
-                        m_physics_world->create_debris(px / PIXELS_PER_METER, top_y, vx, vy,type);
-                    }
                 }
+                if (physics_steps > 0) {
+                    const f32 physics_ms = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start_physics).count();
+                    m_substep_ms = 0.9f * m_substep_ms + 0.1f * physics_ms / static_cast<f32>(physics_steps * substeps);
+                }
+                std::sort(m_moved_bodies.begin(), m_moved_bodies.end());
+                m_moved_bodies.erase(std::unique(m_moved_bodies.begin(), m_moved_bodies.end()), m_moved_bodies.end());
+
+                // re-stamp them in parallel, bodies that moved less than a pixel fraction keep their pixels
+                std::erase_if(m_moved_bodies, [this](BodyID id) { return !keep_in_world(id); });
+                m_displaced.clear();
+                m_rigidbody_manager.restamp(m_moved_bodies, m_sand_world, m_displaced);
+                eject_displaced();
                 
-                // update debris (settling)
-                m_physics_world->update_debris(m_sand_world);
+                // fly debris, landing grains go back into the grid
+                for (i32 step = 0; step < physics_steps; ++step) {
+                    m_debris.update(m_sand_world, m_rigidbody_manager, PHYSICS_DT);
+                }
                 
                 auto mesh_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_mesh - start_mesh).count();
                 auto update_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_update - start_update).count();
                 
                 g_stat_mesh_ms.store(static_cast<i32>(mesh_ms), std::memory_order_relaxed);
                 g_stat_update_ms.store(static_cast<i32>(update_ms), std::memory_order_relaxed);
-                g_stat_debris_count.store(static_cast<i32>(debris_count), std::memory_order_relaxed);
-                g_stat_chains.store(static_cast<i32>(chains.size()), std::memory_order_relaxed);
+                g_stat_debris_count.store(static_cast<i32>(m_debris.size()), std::memory_order_relaxed);
+                g_stat_physics_steps.store(physics_steps, std::memory_order_relaxed);
+                g_stat_substeps.store(substeps, std::memory_order_relaxed);
+                g_stat_chains.store(static_cast<i32>(m_sand_world.chain_count()), std::memory_order_relaxed);
             }
+
+            // stone that lost its hold on the border breaks off as rigid bodies
+            if (m_sand_world.find_islands(m_islands)) {
+                std::lock_guard<std::mutex> lock(m_physics_mutex);
+                for (const auto& island : m_islands) {
+                    detach_island(island);
+                }
+            }
+
+            // solid mask at the end of this step, meshed during the next one
+            if (meshing) {
+                m_sand_world.capture_mesh_snapshot();
+            } else {
+                m_sand_world.suspend_meshing();
+            }
+
+            // hand the finished step over to rendering, which never waits on us (nor we on it)
+            m_sand_world.publish_snapshot();
+            m_debris.publish();
             ////////////////////////////
 
             auto now = std::chrono::steady_clock::now();
@@ -292,21 +382,13 @@ public:
         const f32 water_radius = 80.0f;
         const i32 water_x = static_cast<i32>(center_x + std::cos(t) * water_radius);
         const i32 water_y = static_cast<i32>(center_y + std::sin(t) * water_radius * 0.5f);
-        for (i32 dx = -5; dx <= 5; ++dx) {
-            for (i32 dy = -5; dy <= 5; ++dy) {
-                m_sand_world.setParticle(static_cast<u32>(water_x + dx), static_cast<u32>(water_y + dy), ParticleID::WATER);
-            }
-        }
+        m_sand_world.fill_rect(water_x - 5, water_y - 5, water_x + 6, water_y + 6, ParticleID::WATER);
 
         // Sand spawner orbits counter-clockwise
         const f32 sand_radius = 100.0f;
         const i32 sand_x = static_cast<i32>(center_x + std::cos(-t + SDL_PI_F) * sand_radius);
         const i32 sand_y = static_cast<i32>(center_y + std::sin(-t + SDL_PI_F) * sand_radius * 0.5f);
-        for (i32 dx = -5; dx <= 5; ++dx) {
-            for (i32 dy = -5; dy <= 5; ++dy) {
-                m_sand_world.setParticle(static_cast<u32>(sand_x + dx), static_cast<u32>(sand_y + dy), ParticleID::SAND);
-            }
-        }
+        m_sand_world.fill_rect(sand_x - 5, sand_y - 5, sand_x + 6, sand_y + 6, ParticleID::SAND);
 
         if (iter >= m_benchmark_iterations) {
             Logging::log_info("Benchmark complete: ", m_benchmark_iterations, " iterations");
@@ -352,10 +434,13 @@ public:
             }
         }
         was_fixed = is_fixed;
+
+        // meshing works outwards from what's on screen
+        g_camera_x.store(m_main_scene.m_camera.m_target.x, std::memory_order_relaxed);
+        g_camera_y.store(m_main_scene.m_camera.m_target.y, std::memory_order_relaxed);
         
-        // prevent rendering while sand is extracted
+        // the last published snapshot, no lock
         if (m_sand_world_texture) {
-            std::lock_guard<std::mutex> lock(m_physics_mutex);
             m_sand_world.renderToTexture(m_sand_world_texture);
         }
     }
@@ -371,6 +456,7 @@ public:
                 }
                 if (event->button.button == SDL_BUTTON_LEFT && !imgui_wants_mouse) {
                     m_left_mouse_held = true;
+                    m_stroke_started = false;
                     paint(event->button.x, event->button.y);
                 }
             } break;
@@ -406,35 +492,21 @@ public:
             } break;
 
             case SDL_EVENT_KEY_DOWN: {
+                // R = reset
                 if (event->key.key == SDLK_R) {
-                    std::lock_guard<std::mutex> lock(m_physics_mutex);
-                    m_sand_world.clear();
-                    m_rigidbody_manager.clear();
-                    m_physics_world->reset();
+                    queue_input(ResetWorld{});
                 }
                 
                 // B = spawn crate (box)
                 if (event->key.key == SDLK_B) {
-                    std::lock_guard<std::mutex> lock(m_physics_mutex);
-                    
-                    b2Vec2 world_pos = m_main_scene.m_camera.screenToWorld({m_mouse_x, m_mouse_y});
-                    
-                    // bounds in meters
-                    const f32 max_w = m_sand_world.width() / PIXELS_PER_METER;
-                    const f32 max_h = m_sand_world.height() / PIXELS_PER_METER;
-                    
-                    // box size in meters
-                    const f32 box_size = 1.0f;
-                    const f32 half_size = box_size * 0.5f;
-                    
-                    world_pos.x = std::clamp(world_pos.x, half_size + 0.1f, max_w - half_size - 0.1f);
-                    world_pos.y = std::clamp(world_pos.y, half_size + 0.1f, max_h - half_size - 0.1f);
-                    
-                    // create physics body
-                    b2BodyId bodyId = m_physics_world->create_box(world_pos.x, world_pos.y, box_size, box_size);
-                    
-                    // register with manager to track pixels
-                    m_rigidbody_manager.register_body(bodyId, box_size, box_size, ParticleID::WOOD);
+                    queue_input(SpawnBox{m_main_scene.m_camera.screenToWorld({m_mouse_x, m_mouse_y})});
+                }
+
+                // X = explosion under the mouse
+                if (event->key.key == SDLK_X) {
+                    const b2Vec2 world_pos = m_main_scene.m_camera.screenToWorld({m_mouse_x, m_mouse_y});
+                    const f32 radius = 4.0f * static_cast<f32>(m_main_scene.m_brush_size);
+                    queue_input(Explode{{world_pos.x * PIXELS_PER_METER, world_pos.y * PIXELS_PER_METER}, radius});
                 }
 
                 // D = toggle debug draw
@@ -468,31 +540,274 @@ public:
         return SDL_APP_CONTINUE;
     }
 
+    // enough substeps that the fastest body moves at most a few pixels per substep,
+    // as long as `physics_steps` steps of them fit in the physics budget
+    i32 choose_substeps(i32 physics_steps) const {
+        constexpr i32 MIN_SUBSTEPS = 2;
+        constexpr f32 MAX_TRAVEL = 4.0f / PIXELS_PER_METER; // per substep
+
+        const f32 travel = m_physics_world->max_body_speed() * PHYSICS_DT;
+        const i32 wanted = static_cast<i32>(std::ceil(travel / MAX_TRAVEL));
+
+        i32 cap = g_physics_max_substeps.load(std::memory_order_relaxed);
+        if (m_substep_ms > 0.0f) {
+            const f32 affordable = g_physics_budget_ms.load(std::memory_order_relaxed) / (m_substep_ms * physics_steps);
+            cap = std::min(cap, static_cast<i32>(affordable));
+        }
+        return std::max(std::min(wanted, cap), std::min(MIN_SUBSTEPS, g_physics_max_substeps.load(std::memory_order_relaxed)));
+    }
+
+    // main thread: hands a command to the simulation thread, never waits on it
+    void queue_input(const InputCommand& command) {
+        if (!m_input.push(command)) {
+            Logging::log_warning("Input queue full, dropping a command");
+        }
+    }
+
+    // simulation thread, top of a step: nothing else is touching the grid or the update pool yet
+    // Box2D is read by the debug draw on the main thread, hence the physics lock
+    void apply_input() {
+        std::lock_guard<std::mutex> lock(m_physics_mutex);
+        m_input.drain([this](const InputCommand& command) {
+            if (const auto* stroke = std::get_if<PaintStroke>(&command)) {
+                m_stroke_shape.clear();
+                rasterize_capsule(stroke->from, stroke->to, stroke->radius, m_stroke_shape);
+                m_sand_world.fill_spans(m_stroke_shape, stroke->particle);
+            } else if (const auto* box = std::get_if<SpawnBox>(&command)) {
+                spawn_box(box->position);
+            } else if (const auto* explosion = std::get_if<Explode>(&command)) {
+                m_stroke_shape.clear();
+                rasterize_circle(explosion->center, explosion->radius, m_stroke_shape);
+                carve(m_stroke_shape, explosion->center, EXPLOSION_SPEED);
+            } else if (std::holds_alternative<ResetWorld>(command)) {
+                m_sand_world.clear();
+                m_rigidbody_manager.clear();
+                m_physics_world->reset();
+                m_debris.clear();
+            }
+        });
+    }
+
+    // a wooden crate centered on `position` (meters), kept inside the world
+    void spawn_box(b2Vec2 position) {
+        // bounds in meters
+        const f32 max_w = m_sand_world.width() / PIXELS_PER_METER;
+        const f32 max_h = m_sand_world.height() / PIXELS_PER_METER;
+        
+        // box size in meters
+        const f32 box_size = 1.0f;
+        const f32 half_size = box_size * 0.5f;
+        
+        position.x = std::clamp(position.x, half_size + 0.1f, max_w - half_size - 0.1f);
+        position.y = std::clamp(position.y, half_size + 0.1f, max_h - half_size - 0.1f);
+        
+        // create physics body
+        b2BodyId bodyId = m_physics_world->create_box(position.x, position.y, box_size, box_size);
+        
+        // register with manager to track pixels
+        const BodyID id = m_rigidbody_manager.register_body(bodyId, box_size, box_size);
+        if (id != 0) {
+            m_rigidbody_manager.bake_material(id, ParticleID::WOOD);
+        } else {
+            m_physics_world->destroy_body(bodyId);
+        }
+    }
+
+    // bodies that left the world are destroyed, false for those
+    bool keep_in_world(BodyID id) {
+        const RigidbodyManager::BodyInfo* info = m_rigidbody_manager.find(id);
+        if (!info || !b2Body_IsValid(info->body_id)) {
+            return false;
+        }
+
+        const b2Transform xf = b2Body_GetTransform(info->body_id);
+        const f32 world_w = m_sand_world.width() / PIXELS_PER_METER;
+        const f32 world_h = m_sand_world.height() / PIXELS_PER_METER;
+        if (!std::isfinite(xf.p.x) || !std::isfinite(xf.p.y) || xf.p.x < 0.0f || xf.p.x > world_w || xf.p.y < 0.0f || xf.p.y > world_h) {
+            m_rigidbody_manager.extract_body_pixels(id, m_sand_world);
+            m_physics_world->destroy_body(info->body_id);
+            m_rigidbody_manager.unregister_body(id);
+            return false;
+        }
+        return true;
+    }
+
+    // terrain pixels bodies were stamped over pop out as debris, from the top of the body that displaced them
+    // liquid flows to free cells nearby through the grid instead, only when there is none it becomes debris too
+    void eject_displaced() {
+        BodyID body = 0;
+        f32 top_y = 0.0f;
+        for (const auto& [px, py, type, id] : m_displaced) {
+            if (m_sand_world.is_liquid(type) && m_sand_world.displace_liquid(px, py, type)) {
+                continue;
+            }
+            if (id != body) {
+                body = id;
+                const auto& info = *m_rigidbody_manager.find(id);
+                const b2Transform xf = info.stamped_xf;
+
+                // Calculate spawn height
+                const f32 hx = info.width * 0.5f;
+                const f32 hy = info.height * 0.5f;
+                const b2Vec2 corners[4] = {{-hx, -hy}, {hx, -hy}, {hx, hy}, {-hx, hy}};
+
+                f32 min_y = 1e9f;
+                for(i32 i = 0; i < 4; ++i) {
+                    const b2Vec2 v = b2TransformPoint(xf, corners[i]);
+                    if(v.y < min_y) {
+                        min_y = v.y;
+                    }
+                }
+
+                top_y = min_y - (2.0f / PIXELS_PER_METER);
+            }
+
+            f32 vx = (fast_rand() % 100 - 50) / 25.0f; // soft spread (+/- 2.0)
+            f32 vy = -1.0f - (fast_rand() % 50) / 25.0f; // soft upward pop (-1.0 to -3.0)
+            
+            // spawn at pixel's X, but Body's Top Y
+            m_debris.spawn(px / PIXELS_PER_METER, top_y, vx, vy, type);
+        }
+    }
+
+    // blows the terrain cells of `shape` out of the grid as debris flying away from `center` (pixels)
+    // rigid bodies are left in one piece, the ones caught in the shape get pushed away instead
+    // simulation thread only, under the physics lock: the grid is cleared on the update pool
+    void carve(std::span<const Span> shape, b2Vec2 center, f32 speed) {
+        m_carved_bodies.clear();
+        m_sand_world.query_spans(shape, SandWorld<7, 5>::ANY_MATERIAL, [this](i32, i32, ParticleID, BodyID body) {
+            if (body != 0) {
+                m_carved_bodies.push_back(body);
+            }
+        });
+        std::sort(m_carved_bodies.begin(), m_carved_bodies.end());
+        m_carved_bodies.erase(std::unique(m_carved_bodies.begin(), m_carved_bodies.end()), m_carved_bodies.end());
+        for (const BodyID id : m_carved_bodies) {
+            const RigidbodyManager::BodyInfo* info = m_rigidbody_manager.find(id);
+            if (!info || !b2Body_IsValid(info->body_id)) {
+                continue;
+            }
+            const b2Vec2 p = b2Body_GetWorldCenterOfMass(info->body_id);
+            b2Vec2 dir = {p.x * PIXELS_PER_METER - center.x, p.y * PIXELS_PER_METER - center.y};
+            const f32 distance = b2Length(dir);
+            dir = distance > 0.0f ? b2Vec2{dir.x / distance, dir.y / distance} : b2Vec2{0.0f, -1.0f};
+            const f32 impulse = 0.5f * speed * b2Body_GetMass(info->body_id);
+            b2Body_ApplyLinearImpulseToCenter(info->body_id, {dir.x * impulse, dir.y * impulse}, true);
+        }
+
+        m_carved.clear();
+        m_sand_world.carve(shape, SandWorld<7, 5>::ANY_MATERIAL, m_carved);
+        m_debris.eject(m_carved, center, speed);
+    }
+
+    // turns an island into a dynamic body, its pixels stay where they are and now belong to the body
+    // one box shape per rect, too jagged an island crumbles into debris instead (or stays terrain if it's big)
+    void detach_island(const SandWorld<7, 5>::Island& island) {
+        constexpr u64 MAX_ISLAND_SHAPES = 64;
+        constexpr u32 MAX_CRUMBLE_PIXELS = 4096;
+        constexpr f32 CRUMBLE_SPEED = 1.0f; // meters per second
+
+        const f32 width = (island.max_x - island.min_x + 1) / PIXELS_PER_METER;
+        const f32 height = (island.max_y - island.min_y + 1) / PIXELS_PER_METER;
+        const b2Vec2 center = {(island.min_x + island.max_x + 1) * 0.5f / PIXELS_PER_METER,
+                               (island.min_y + island.max_y + 1) * 0.5f / PIXELS_PER_METER};
+
+        merge_island_rects(island.rects, m_island_rects);
+        if (m_island_rects.size() > MAX_ISLAND_SHAPES) {
+            if (island.pixel_count > MAX_CRUMBLE_PIXELS) {
+                return; // stays terrain, it's looked at again once something around it changes
+            }
+            m_carve_shape.clear();
+            for (const auto& r : m_island_rects) {
+                rasterize_rect(r.x, r.y, r.x + r.w, r.y + r.h, m_carve_shape);
+            }
+            m_carved.clear();
+            m_sand_world.carve(m_carve_shape, SandWorld<7, 5>::ANY_MATERIAL, m_carved);
+            m_debris.eject(m_carved, {center.x * PIXELS_PER_METER, center.y * PIXELS_PER_METER}, CRUMBLE_SPEED);
+            return;
+        }
+
+        m_island_boxes.clear();
+        for (const auto& r : m_island_rects) {
+            const b2Vec2 box_center = {(r.x + r.w * 0.5f) / PIXELS_PER_METER - center.x, (r.y + r.h * 0.5f) / PIXELS_PER_METER - center.y};
+            m_island_boxes.push_back(b2MakeOffsetBox(r.w * 0.5f / PIXELS_PER_METER, r.h * 0.5f / PIXELS_PER_METER, box_center, b2Rot_identity));
+        }
+
+        const b2BodyId body_id = m_physics_world->create_compound_body(center, m_island_boxes);
+        const BodyID id = m_rigidbody_manager.register_body(body_id, width, height);
+        if (id == 0) {
+            m_physics_world->destroy_body(body_id); // out of body ids, it stays terrain for now
+            return;
+        }
+        m_rigidbody_manager.mark_stamped(id, m_sand_world.width(), m_sand_world.height());
+
+        for (const auto& r : m_island_rects) {
+            for (i32 y = r.y; y < r.y + r.h; ++y) {
+                for (i32 x = r.x; x < r.x + r.w; ++x) {
+                    m_sand_world.set_body_particle(x, y, m_sand_world.getParticle(x, y).id, id);
+                    m_sand_world.mark_chunk_dirty(x, y);
+                }
+            }
+        }
+        m_rigidbody_manager.bake_from_world(id, m_sand_world);
+    }
+
+    // the row runs of an island joined into fewer, bigger rects: stacked ones with the same x span, then
+    // side by side ones with the same y span
+    static void merge_island_rects(const std::vector<SandWorld<7, 5>::PixelRect>& rects, std::vector<SandWorld<7, 5>::PixelRect>& out) {
+        out.assign(rects.begin(), rects.end());
+
+        const auto merge = [&out](auto before, auto touching, auto grow) {
+            std::sort(out.begin(), out.end(), before);
+            u64 n = 0;
+            for (const auto& r : out) {
+                if (n > 0 && touching(out[n - 1], r)) {
+                    grow(out[n - 1], r);
+                } else {
+                    out[n++] = r;
+                }
+            }
+            out.resize(n);
+        };
+
+        using Rect = SandWorld<7, 5>::PixelRect;
+        merge([](const Rect& a, const Rect& b) { return std::tie(a.x, a.w, a.y) < std::tie(b.x, b.w, b.y); },
+              [](const Rect& a, const Rect& b) { return a.x == b.x && a.w == b.w && a.y + a.h == b.y; },
+              [](Rect& a, const Rect& b) { a.h += b.h; });
+        merge([](const Rect& a, const Rect& b) { return std::tie(a.y, a.h, a.x) < std::tie(b.y, b.h, b.x); },
+              [](const Rect& a, const Rect& b) { return a.y == b.y && a.h == b.h && a.x + a.w == b.x; },
+              [](Rect& a, const Rect& b) { a.w += b.w; });
+    }
+
+    // queues a brush stroke from the previous mouse sample, so fast moves leave a continuous line
     void paint(f32 screen_x, f32 screen_y) {
         const b2Vec2 world_pos = m_main_scene.m_camera.screenToWorld({screen_x, screen_y});
         
-        const f32 size_w = static_cast<f32>(m_sand_world.width()) / PIXELS_PER_METER;
-        const f32 size_h = static_cast<f32>(m_sand_world.height()) / PIXELS_PER_METER;
-        
         const i32 center_x = static_cast<i32>(world_pos.x * PIXELS_PER_METER);
         const i32 center_y = static_cast<i32>(world_pos.y * PIXELS_PER_METER);
         
         const i32 brush_radius = m_main_scene.m_brush_size - 1;  // size 1 = radius 0 = single pixel
         const ParticleID particle = static_cast<ParticleID>(m_main_scene.m_selected_particle);
         
-        // Draw a filled circle
-        for (i32 dy = -brush_radius; dy <= brush_radius; ++dy) {
-            for (i32 dx = -brush_radius; dx <= brush_radius; ++dx) {
-                if (dx * dx + dy * dy <= brush_radius * brush_radius) {
-                    const i32 px = center_x + dx;
-                    const i32 py = center_y + dy;
-                    if (px >= 0 && px < static_cast<i32>(m_sand_world.width()) &&
-                        py >= 0 && py < static_cast<i32>(m_sand_world.height())) {
-                        m_sand_world.setParticle(static_cast<u32>(px), static_cast<u32>(py), particle);
-                    }
-                }
-            }
+        // cells with dx^2 + dy^2 <= r^2, the radius is nudged so the ones right on it stay in
+        const f32 radius = std::sqrt(static_cast<f32>(brush_radius * brush_radius) + 0.5f);
+        const b2Vec2 to = {center_x + 0.5f, center_y + 0.5f};
+        const PaintStroke stroke = {m_stroke_started ? m_last_stroke.to : to, to, radius, particle};
+
+        // holding still while the simulation is paused would only queue the same dab again and again
+        const u32 step = g_sim_step_count.load(std::memory_order_relaxed);
+        const bool same_dab = m_stroke_started && m_last_stroke.from.x == to.x && m_last_stroke.from.y == to.y &&
+                              m_last_stroke.to.x == to.x && m_last_stroke.to.y == to.y &&
+                              m_last_stroke.radius == radius && m_last_stroke.particle == particle;
+        if (same_dab && step == m_last_stroke_step) {
+            return;
         }
+
+        // a full queue means the simulation is far behind, losing brush samples is fine
+        m_input.push(stroke);
+        m_last_stroke = stroke;
+        m_last_stroke_step = step;
+        m_stroke_started = true;
     }
 
     bool m_right_mouse_held = false;
@@ -521,7 +836,32 @@ public:
     // Physics
     std::unique_ptr<PhysicsWorld> m_physics_world;
     RigidbodyManager m_rigidbody_manager;
-    ThreadPool m_mesh_thread_pool;
+    DebrisSystem m_debris;
     std::mutex m_physics_mutex;
     bool m_debug_draw = false;
+
+    // reused by the simulation thread every step
+    std::vector<b2AABB> m_collision_regions;
+    std::vector<b2AABB> m_awake_regions;
+    std::vector<BodyID> m_moved_bodies;
+    std::vector<RigidbodyManager::Displaced> m_displaced;
+    f32 m_physics_accumulator = 0.0f; // seconds of physics not stepped yet
+    f32 m_substep_ms = 0.0f;          // running average cost of one substep
+    std::vector<SandWorld<7, 5>::Island> m_islands;
+    std::vector<b2Polygon> m_island_boxes;
+    std::vector<SandWorld<7, 5>::PixelRect> m_island_rects;
+    std::vector<Span> m_carve_shape;
+
+    // input, from the main thread to the simulation thread
+    CommandQueue<InputCommand, 1024> m_input;
+    std::vector<Span> m_stroke_shape;
+
+    // main thread brush state
+    bool m_stroke_started = false;
+    PaintStroke m_last_stroke{};
+    u32 m_last_stroke_step = 0;
+
+    static constexpr f32 EXPLOSION_SPEED = 12.0f; // meters per second at the center
+    std::vector<SandWorld<7, 5>::CarvedCell> m_carved;
+    std::vector<BodyID> m_carved_bodies;
 };
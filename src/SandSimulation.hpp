@@ -3,14 +3,18 @@
 #include <SDL3/SDL.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <utility>
 #include <mutex>
 #include <box2d/box2d.h>
 #include <vector>
+#include <bit>
 #include <bitset>
+#include <chrono>
 #include <map>
 #include <tuple>
 #include <cmath>
+#include <span>
 
 #include "Array2D.hpp"
 #include "Commons.hpp"
@@ -18,6 +22,9 @@
 #include "ThreadPool.hpp"
 #include "GlobalAtomics.hpp"
 #include "Camera.hpp"
+#include "Polylines.hpp"
+#include "SpanRaster.hpp"
+#include "TripleBuffer.hpp"
 
 // Douglas-Peucker simplification threshold 
 static constexpr f32 SIMPLIFICATION_EPSILON = 0.0001f;
@@ -52,9 +59,12 @@ static const std::array<SDL_FColor, 5> particle_colors = {{
 
 static std::array<u32, 5> particle_colors_u32;
 
+// rigid body owning a pixel, 0 = terrain/free
+// kept in its own plane next to the particles, the sand step never needs it
+using BodyID = u16;
+
 struct Particle {
     ParticleID id;    // Material type (u8)
-    u8 body_id;       // 0 = terrain/free, 1-255 = rigidbody ID
     u16 lifetime;     // Top bit = settled flag, lower 15 bits = lifetime in ms
     
     static constexpr u16 SETTLED_FLAG = 0b1000000000000000;
@@ -72,6 +82,7 @@ class SandWorld {
 public:
     SandWorld() {
         clear();
+        m_uploaded_versions.fill(UINT32_MAX); // the texture starts out undefined, all of it goes up first
 
         const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails(SDL_PIXELFORMAT_RGBA8888);
         for (u64 i = 0; i < particle_colors.size(); ++i) {
@@ -80,14 +91,9 @@ public:
         }
     }
     
-    // terrain mesh pixels
-    bool is_static_solid(i32 x, i32 y) const {
-        if (x < 0 || x >= (i32)width() || y < 0 || y >= (i32)height()) {
-            return false;
-        } 
-
-        const auto& p = m_particles((u32)x, (u32)y);
-        switch (p.id) {
+    // terrain mesh materials
+    static constexpr bool is_solid_material(ParticleID id) {
+        switch (id) {
             case ParticleID::STONE:
             case ParticleID::SAND:
                 return true;
@@ -95,13 +101,122 @@ public:
                 return false;
         }
     }
+
+    // terrain mesh pixels, rigid body pixels never are whatever their material
+    static constexpr bool is_static_solid(ParticleID id, BodyID body_id) {
+        return is_solid_material(id) && body_id == 0;
+    }
+
+    bool is_static_solid(i32 x, i32 y) const {
+        if (x < 0 || x >= (i32)width() || y < 0 || y >= (i32)height()) {
+            return false;
+        } 
+
+        return is_static_solid(m_particles((u32)x, (u32)y).id, m_body_ids((u32)x, (u32)y));
+    }
+
+    // stone holds itself up, anything else resting on it doesn't
+    static constexpr bool is_anchoring(ParticleID id, BodyID body_id) {
+        return id == ParticleID::STONE && body_id == 0;
+    }
+
+    bool is_anchoring(u32 x, u32 y) const {
+        return is_anchoring(m_particles(x, y).id, m_body_ids(x, y));
+    }
+
+    void set_particle_id(u32 x, u32 y, ParticleID id) {
+        set_body_particle(x, y, id, m_body_ids(x, y));
+    }
+
+    // every material or body write goes through here, keeping `m_solid_bits` and the island labels in sync
+    void set_body_particle(u32 x, u32 y, ParticleID id, BodyID body_id) {
+        // the sand step never touches stone, so this only happens on the simulation thread
+        if (set_body_particle_concurrent(x, y, id, body_id)) {
+            mark_island_dirty(x, y);
+        }
+    }
+
+    // same, for writers running concurrently on disjoint pixels: leaves the island bookkeeping to the caller
+    // returns whether the pixel started or stopped anchoring, `mark_island_dirty` it once back on one thread
+    // neighbouring chunks can be updated concurrently and share mask words, hence the atomics
+    bool set_body_particle_concurrent(u32 x, u32 y, ParticleID id, BodyID body_id) {
+        Particle& p = m_particles(x, y);
+        BodyID& body = m_body_ids(x, y);
+        const bool was_solid = is_static_solid(p.id, body);
+        const bool was_anchoring = is_anchoring(p.id, body);
+        const bool was_empty = p.id == ParticleID::AIR;
+        if (p.id != id) {
+            mark_chunk_changed(x, y);
+        }
+        p.id = id;
+        body = body_id;
+        const bool solid = is_static_solid(id, body_id);
+
+        if (was_empty != (id == ParticleID::AIR)) {
+            add_occupancy(x, y, was_empty ? 1 : -1);
+        }
+
+        if (was_solid != solid) {
+            set_solid_bit(x, y, solid);
+        }
+        return was_anchoring != is_anchoring(id, body_id);
+    }
+
+    // neighbouring chunks can be updated concurrently and share mask words, hence the atomics
+    void set_solid_bit(u32 x, u32 y, bool solid) {
+        std::atomic_ref<u64> word(m_solid_bits(x / 64, y));
+        const u64 bit = u64(1) << (x % 64);
+        if (solid) {
+            word.fetch_or(bit, std::memory_order_relaxed);
+        } else {
+            word.fetch_and(~bit, std::memory_order_relaxed);
+        }
+    }
+
+    // a cell's material changed, its chunk goes out with the next snapshot
+    // concurrent chunk updates write neighbouring chunks too, hence the atomic (looked at first, it's usually set)
+    void mark_chunk_changed(u32 x, u32 y) {
+        std::atomic_ref<u8> changed(m_chunk_changed(x / CHUNK_WIDTH, y / CHUNK_HEIGHT));
+        if (!changed.load(std::memory_order_relaxed)) {
+            changed.store(1, std::memory_order_relaxed);
+        }
+    }
+
+    void mark_island_dirty(u32 x, u32 y) {
+        m_island_dirty.set(x / CHUNK_WIDTH, y / CHUNK_HEIGHT);
+    }
+
+    // non-AIR cell counts per tile and per chunk, for the queries to skip empty space
+    // cells near chunk edges are written by neighbouring chunks' updates too, hence the atomics
+    void add_occupancy(u32 x, u32 y, i32 delta) {
+        std::atomic_ref<u16>(m_tile_counts(x / TILE_SIZE, y / TILE_SIZE)).fetch_add(static_cast<u16>(delta), std::memory_order_relaxed);
+        std::atomic_ref<u16>(m_chunk_counts(x / CHUNK_WIDTH, y / CHUNK_HEIGHT)).fetch_add(static_cast<u16>(delta), std::memory_order_relaxed);
+    }
+
+    // a particle moved from one cell to another
+    void move_occupancy(u32 from_x, u32 from_y, u32 to_x, u32 to_y) {
+        if (from_x / TILE_SIZE != to_x / TILE_SIZE || from_y / TILE_SIZE != to_y / TILE_SIZE) {
+            add_occupancy(to_x, to_y, 1);
+            add_occupancy(from_x, from_y, -1);
+        }
+    }
+
+    const auto& solid_bits() const { return m_solid_bits; }
     
     bool is_chunk_dirty(u32 chunk_x, u32 chunk_y) const {
         if (chunk_x >= WIDTH || chunk_y >= HEIGHT) {
             return false;
         }
 
-        return m_dirty_chunks(chunk_x, chunk_y);
+        return m_dirty_chunks(chunk_x, chunk_y) != 0;
+    }
+
+    // neighbouring chunks update concurrently and mark each other, hence the atomic (looked at first, it's usually set)
+    void set_chunk_dirty(u32 chunk_x, u32 chunk_y) {
+        std::atomic_ref<u8> dirty(m_dirty_chunks(chunk_x, chunk_y));
+        if (!dirty.load(std::memory_order_relaxed)) {
+            dirty.store(1, std::memory_order_relaxed);
+        }
     }
     
     void mark_chunk_dirty(u32 x_pixel, u32 y_pixel) {
@@ -110,7 +225,7 @@ public:
         const u32 cy = y_pixel / CHUNK_HEIGHT;
 
         if (cx < WIDTH && cy < HEIGHT) {
-            m_dirty_chunks.set(cx, cy);
+            set_chunk_dirty(cx, cy);
             
             // pixel coords relative to chunk
             const u32 lx = x_pixel % CHUNK_WIDTH;
@@ -118,16 +233,16 @@ public:
             
             // mark neighbors if on edge
             if (lx == 0 && cx > 0) { // left edge
-                m_dirty_chunks.set(cx - 1, cy);
+                set_chunk_dirty(cx - 1, cy);
             }
             if (lx == CHUNK_WIDTH - 1 && cx < WIDTH - 1) { // right edge
-                m_dirty_chunks.set(cx + 1, cy);
+                set_chunk_dirty(cx + 1, cy);
             }
             if (ly == 0 && cy > 0) { // top edge
-                m_dirty_chunks.set(cx, cy - 1);
+                set_chunk_dirty(cx, cy - 1);
             }
             if (ly == CHUNK_HEIGHT - 1 && cy < HEIGHT - 1) { // bottom edge
-                m_dirty_chunks.set(cx, cy + 1);
+                set_chunk_dirty(cx, cy + 1);
             }
         }
     }
@@ -144,8 +259,7 @@ public:
             const u32 ny = y + dy;
 
             if (m_particles(nx, ny).id == ParticleID::AIR) {
-                m_particles(nx, ny).id = ParticleID::SAND;
-                m_particles(x, y).id = ParticleID::AIR;
+                move_sand(x, y, nx, ny);
 
                 m_updated_particles.set(nx, ny);
 
@@ -153,8 +267,7 @@ public:
                 mark_chunk_dirty(x, y);
                 return;
             } else if (m_particles(nx, ny).id == ParticleID::WATER) {
-                m_particles(nx, ny).id = ParticleID::SAND;
-                m_particles(x, y).id = ParticleID::WATER;
+                move_sand(x, y, nx, ny);
 
                 m_updated_particles.set(nx, ny);
 
@@ -167,11 +280,30 @@ public:
         }
     }
 
+    // sand trades places with the air or water below it; none of the three is ever a body pixel or anchoring,
+    // so only the solid bits (sand is solid) and the occupancy (when it swaps with air) follow
+    void move_sand(u32 x, u32 y, u32 nx, u32 ny) {
+        const ParticleID other = m_particles(nx, ny).id;
+        m_particles(nx, ny).id = ParticleID::SAND;
+        m_particles(x, y).id = other;
+        if (other == ParticleID::AIR) {
+            move_occupancy(x, y, nx, ny);
+        }
+        set_solid_bit(nx, ny, true);
+        set_solid_bit(x, y, false);
+        mark_chunk_changed(nx, ny);
+        mark_chunk_changed(x, y);
+    }
+
+    // water only ever swaps with air, neither is solid so the solid mask is left alone
     void update_water(const u32 x, const u32 y) {
         // straight down
         if (m_particles(x, y + 1).id == ParticleID::AIR) {
             m_particles(x, y + 1).id = ParticleID::WATER;
             m_particles(x, y).id = ParticleID::AIR;
+            move_occupancy(x, y, x, y + 1);
+            mark_chunk_changed(x, y + 1);
+            mark_chunk_changed(x, y);
             m_updated_particles.set(x, y + 1);
             mark_chunk_dirty(x, y + 1);
             mark_chunk_dirty(x, y);
@@ -217,6 +349,9 @@ public:
             if (cur_x != x || cur_y != y) {
                 m_particles(cur_x, cur_y).id = ParticleID::WATER;
                 m_particles(x, y).id = ParticleID::AIR;
+                move_occupancy(x, y, cur_x, cur_y);
+                mark_chunk_changed(cur_x, cur_y);
+                mark_chunk_changed(x, y);
 
                 m_updated_particles.set(cur_x, cur_y);
 
@@ -238,140 +373,835 @@ public:
         try_spread(!go_left);
     }
 
+    static constexpr bool is_liquid(ParticleID id) {
+        return id == ParticleID::WATER;
+    }
+
+    // liquid a rigid body was stamped over flows to the nearest free cell instead, through air and the same
+    // liquid only: a breadth-first search around (x, y), the body's own pixel, bounded to LIQUID_SEARCH_RADIUS
+    // returns false when there is no room that close, the caller gets rid of it some other way
+    bool displace_liquid(u32 x, u32 y, ParticleID type) {
+        constexpr i32 R = LIQUID_SEARCH_RADIUS;
+        constexpr i32 SIDE = 2 * R + 1;
+        static constexpr std::pair<i32, i32> dirs[] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1}}; // up first, liquid rises around bodies
+
+        m_liquid_visited.assign(SIDE * SIDE, false);
+        m_liquid_queue.clear();
+        m_liquid_queue.push_back({0, 0});
+        m_liquid_visited[R * SIDE + R] = true;
+
+        for (u64 head = 0; head < m_liquid_queue.size(); ++head) {
+            const auto [ox, oy] = m_liquid_queue[head];
+            for (auto [dx, dy] : dirs) {
+                const i32 nx = ox + dx;
+                const i32 ny = oy + dy;
+                if (nx < -R || nx > R || ny < -R || ny > R || m_liquid_visited[(ny + R) * SIDE + nx + R]) {
+                    continue;
+                }
+                m_liquid_visited[(ny + R) * SIDE + nx + R] = true;
+
+                const i32 px = static_cast<i32>(x) + nx;
+                const i32 py = static_cast<i32>(y) + ny;
+                if (px <= 0 || py <= 0 || px >= static_cast<i32>(width()) - 1 || py >= static_cast<i32>(height()) - 1 ||
+                    m_body_ids(px, py) != 0) {
+                    continue;
+                }
+
+                const ParticleID id = m_particles(px, py).id;
+                if (id == ParticleID::AIR) {
+                    set_particle_id(px, py, type);
+                    mark_chunk_dirty(px, py);
+                    return true;
+                }
+                if (id == type) {
+                    m_liquid_queue.push_back({nx, ny});
+                }
+            }
+        }
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Queries, in pixels
+    // Empty 8x8 tiles and chunks are skipped using the occupancy counts every write keeps up to date,
+    // so rays and shapes crossing open air cost next to nothing. Call between steps, on the simulation thread.
+
+    static constexpr u32 TILE_SIZE = 8;
+    static_assert(CHUNK_WIDTH % TILE_SIZE == 0 && CHUNK_HEIGHT % TILE_SIZE == 0, "tiles must not straddle chunks");
+
+    static constexpr u32 material_bit(ParticleID id) { return 1u << static_cast<u32>(id); }
+    static constexpr u32 ANY_MATERIAL = ~material_bit(ParticleID::AIR);
+
+    struct Ray {
+        b2Vec2 origin;
+        b2Vec2 direction; // needn't be normalized
+        f32 max_distance;
+        u32 mask = ANY_MATERIAL;
+    };
+
+    struct RayHit {
+        bool hit = false;
+        i32 x = 0, y = 0;
+        ParticleID id = ParticleID::AIR;
+        BodyID body_id = 0;
+        f32 distance = 0.0f;
+        i32 normal_x = 0, normal_y = 0; // face the ray entered the cell through, 0 when it started inside
+    };
+
+    // first cell along the ray whose material is in `mask`
+    // DDA through the cells, jumping whole tiles and chunks while they are empty
+    RayHit raycast(b2Vec2 origin, b2Vec2 direction, f32 max_distance, u32 mask = ANY_MATERIAL) const {
+        RayHit result;
+        const f32 length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+        if (length == 0.0f || !(max_distance > 0.0f)) {
+            return result;
+        }
+        const b2Vec2 d = {direction.x / length, direction.y / length};
+
+        f32 t = 0.0f;
+        f32 t_end = max_distance;
+        if (!clip_ray(origin.x, d.x, static_cast<f32>(width()), t, t_end) || !clip_ray(origin.y, d.y, static_cast<f32>(height()), t, t_end)) {
+            return result;
+        }
+
+        const i32 w = static_cast<i32>(width());
+        const i32 h = static_cast<i32>(height());
+        const i32 step_x = d.x > 0.0f ? 1 : (d.x < 0.0f ? -1 : 0);
+        const i32 step_y = d.y > 0.0f ? 1 : (d.y < 0.0f ? -1 : 0);
+        const f32 inv_x = step_x != 0 ? 1.0f / d.x : 0.0f;
+        const f32 inv_y = step_y != 0 ? 1.0f / d.y : 0.0f;
+
+        // cells are half-open: a ray on the far right or bottom face only gets in if it heads inwards
+        // and doesn't leave through the other axis right away (t == t_end, a corner)
+        const b2Vec2 start = {origin.x + d.x * t, origin.y + d.y * t};
+        if ((start.x >= w && (step_x >= 0 || t == t_end)) || (start.y >= h && (step_y >= 0 || t == t_end))) {
+            return result;
+        }
+        // entering through those faces lands on the last cell
+        i32 cx = std::clamp(static_cast<i32>(std::floor(start.x)), 0, w - 1);
+        i32 cy = std::clamp(static_cast<i32>(std::floor(start.y)), 0, h - 1);
+        i32 nx = 0;
+        i32 ny = 0;
+
+        while (t <= t_end) {
+            // biggest empty box around the cell: its chunk, its tile, or the cell itself
+            i32 sx = 1;
+            i32 sy = 1;
+            if (m_chunk_counts(cx / CHUNK_WIDTH, cy / CHUNK_HEIGHT) == 0) {
+                sx = CHUNK_WIDTH;
+                sy = CHUNK_HEIGHT;
+            } else if (m_tile_counts(cx / TILE_SIZE, cy / TILE_SIZE) == 0) {
+                sx = sy = TILE_SIZE;
+            } else {
+                const ParticleID id = m_particles(cx, cy).id;
+                if (mask & material_bit(id)) {
+                    result = {true, cx, cy, id, m_body_ids(cx, cy), t, nx, ny};
+                    return result;
+                }
+            }
+
+            // leave the box through whichever face comes first
+            const i32 bx = cx - cx % sx;
+            const i32 by = cy - cy % sy;
+            const f32 tx = step_x > 0 ? (bx + sx - origin.x) * inv_x : (step_x < 0 ? (bx - origin.x) * inv_x : INFINITY);
+            const f32 ty = step_y > 0 ? (by + sy - origin.y) * inv_y : (step_y < 0 ? (by - origin.y) * inv_y : INFINITY);
+            if (tx < ty) {
+                t = tx;
+                cx = step_x > 0 ? bx + sx : bx - 1;
+                cy = std::clamp(static_cast<i32>(std::floor(origin.y + d.y * t)), by, by + sy - 1);
+                nx = -step_x;
+                ny = 0;
+            } else {
+                t = ty;
+                cy = step_y > 0 ? by + sy : by - 1;
+                cx = std::clamp(static_cast<i32>(std::floor(origin.x + d.x * t)), bx, bx + sx - 1);
+                nx = 0;
+                ny = -step_y;
+            }
+            if (cx < 0 || cy < 0 || cx >= w || cy >= h) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    // many rays at once, spread over the pool when there are enough of them
+    void raycast_batch(std::span<const Ray> rays, std::span<RayHit> hits) {
+        constexpr u64 RAYS_PER_TASK = 256;
+
+        const auto cast = [this, rays, hits](u64 begin, u64 end) {
+            for (u64 i = begin; i < end; ++i) {
+                hits[i] = raycast(rays[i].origin, rays[i].direction, rays[i].max_distance, rays[i].mask);
+            }
+        };
+        if (rays.size() <= RAYS_PER_TASK) {
+            cast(0, rays.size());
+            return;
+        }
+        for (u64 begin = 0; begin < rays.size(); begin += RAYS_PER_TASK) {
+            m_thread_pool.enqueue([&cast, begin, end = std::min<u64>(begin + RAYS_PER_TASK, rays.size())] { cast(begin, end); });
+        }
+        m_thread_pool.wait_all();
+    }
+
+    // calls `f(x, y, id, body_id)` for every cell of `spans` whose material is in `mask`
+    template <typename F>
+    void query_spans(std::span<const Span> spans, u32 mask, F&& f) const {
+        const i32 w = static_cast<i32>(width());
+        const i32 h = static_cast<i32>(height());
+        for (const Span& s : spans) {
+            if (s.y < 0 || s.y >= h) {
+                continue;
+            }
+            i32 x = std::max(s.x0, 0);
+            const i32 x_end = std::min(s.x1, w);
+            while (x < x_end) {
+                const i32 tile_end = std::min(x_end, (x / static_cast<i32>(TILE_SIZE) + 1) * static_cast<i32>(TILE_SIZE));
+                if (m_tile_counts(x / TILE_SIZE, s.y / TILE_SIZE) == 0) {
+                    x = tile_end;
+                    continue;
+                }
+                for (; x < tile_end; ++x) {
+                    const ParticleID id = m_particles(x, s.y).id;
+                    if (mask & material_bit(id)) {
+                        f(x, s.y, id, m_body_ids(x, s.y));
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename F>
+    void query_circle(b2Vec2 center, f32 radius, u32 mask, F&& f) {
+        m_query_spans.clear();
+        rasterize_circle(center, radius, m_query_spans);
+        query_spans(m_query_spans, mask, f);
+    }
+
+    // cells [min_x, max_x) x [min_y, max_y)
+    template <typename F>
+    void query_aabb(i32 min_x, i32 min_y, i32 max_x, i32 max_y, u32 mask, F&& f) {
+        m_query_spans.clear();
+        rasterize_rect(min_x, std::max(min_y, 0), max_x, std::min(max_y, static_cast<i32>(height())), m_query_spans);
+        query_spans(m_query_spans, mask, f);
+    }
+
+    // cells of `mask` materials in the circle
+    u32 count_in_circle(b2Vec2 center, f32 radius, u32 mask = ANY_MATERIAL) {
+        u32 count = 0;
+        query_circle(center, radius, mask, [&count](i32, i32, ParticleID, BodyID) { ++count; });
+        return count;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Region edits
+    // Whole shapes written as row spans: clipped to the interior once (the stone border stays), rows spread
+    // over the pool when the shape is large, covered chunks marked dirty in one pass. Rigid body pixels
+    // belong to their body and are left alone.
+    // Simulation thread, or any thread while the pool is idle: large edits borrow it.
+
+    void fill_spans(std::span<const Span> spans, ParticleID id) {
+        edit_spans(spans, [this, id](i32 x, i32 y, EditScratch&) {
+            return m_body_ids(x, y) == 0 && set_body_particle_concurrent(x, y, id, 0);
+        });
+    }
+
+    // cells [min_x, max_x) x [min_y, max_y)
+    void fill_rect(i32 min_x, i32 min_y, i32 max_x, i32 max_y, ParticleID id) {
+        m_edit_shape.clear();
+        rasterize_rect(min_x, std::max(min_y, 0), max_x, std::min(max_y, static_cast<i32>(height())), m_edit_shape);
+        fill_spans(m_edit_shape, id);
+    }
+
+    void fill_circle(b2Vec2 center, f32 radius, ParticleID id) {
+        m_edit_shape.clear();
+        rasterize_circle(center, radius, m_edit_shape);
+        fill_spans(m_edit_shape, id);
+    }
+
+    // convex, in pixels
+    void fill_polygon(std::span<const b2Vec2> vertices, ParticleID id) {
+        m_edit_shape.clear();
+        rasterize_convex(vertices, m_edit_shape);
+        fill_spans(m_edit_shape, id);
+    }
+
+    // copies a grid of materials (anything with width(), height() and (x, y) giving a ParticleID) with its
+    // top-left corner at (dst_x, dst_y); AIR in a `transparent` source leaves the world cell as it is
+    template <typename Grid>
+    void blit(const Grid& source, i32 dst_x, i32 dst_y, bool transparent = false) {
+        const i32 w = static_cast<i32>(source.width());
+        const i32 h = static_cast<i32>(source.height());
+        m_edit_shape.clear();
+        rasterize_rect(dst_x, std::max(dst_y, 0), dst_x + w, std::min(dst_y + h, static_cast<i32>(height())), m_edit_shape);
+        edit_spans(m_edit_shape, [this, &source, dst_x, dst_y, transparent](i32 x, i32 y, EditScratch&) {
+            const ParticleID id = source(static_cast<u32>(x - dst_x), static_cast<u32>(y - dst_y));
+            if ((transparent && id == ParticleID::AIR) || m_body_ids(x, y) != 0) {
+                return false;
+            }
+            return set_body_particle_concurrent(x, y, id, 0);
+        });
+    }
+
+    struct CarvedCell {
+        i32 x, y;
+        ParticleID id;
+    };
+
+    // clears the terrain cells of `spans` whose material is in `mask`, appending them to `removed`
+    void carve(std::span<const Span> spans, u32 mask, std::vector<CarvedCell>& removed) {
+        const u64 tasks = edit_spans(spans, [this, mask](i32 x, i32 y, EditScratch& scratch) {
+            const ParticleID id = m_particles(x, y).id;
+            if (!(mask & material_bit(id)) || m_body_ids(x, y) != 0) {
+                return false;
+            }
+            scratch.removed.push_back({x, y, id});
+            return set_body_particle_concurrent(x, y, ParticleID::AIR, 0);
+        });
+        for (u64 t = 0; t < tasks; ++t) {
+            removed.insert(removed.end(), m_edit_scratch[t].removed.begin(), m_edit_scratch[t].removed.end());
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     // FIXME: THE SET OF FUNCTIONS BELOW IS HIGHLY INEFFICIENT
     // Also, I suspect there are still bugs in it :/
     
+    static constexpr u32 NO_OWNER = UINT32_MAX;
+
+    static_assert(CHUNK_WIDTH % 64 == 0, "solid mask words must not straddle chunks");
+    static constexpr u32 CHUNK_WORDS = CHUNK_WIDTH / 64;
+
+    // the chunk's solid pixels plus the one pixel ring around it (corners excluded, meshing never looks diagonally)
+    struct SolidMask {
+        std::array<u64, (CHUNK_HEIGHT + 2) * CHUNK_WORDS> rows; // chunk rows plus the row above and below
+        std::bitset<CHUNK_HEIGHT> left, right;                  // columns just outside the chunk
+        bool operator==(const SolidMask&) const = default;
+    };
+
+    struct Segment {
+        b2Vec2 p1, p2;
+    };
+
     struct ChunkCache {
         // a chain is simply a list of vertices that form a polygon
-        std::vector<std::vector<b2Vec2>> chains;
+        // as meshed: contours leaving the chunk are cut at its border (open), the rest are loops
+        Polylines chains;
+        // per chain, the chunk whose `merged` it ended up in (NO_OWNER = not stitched yet)
+        std::vector<u32> chain_owner;
+
+        // `is_static_solid` pattern the chains were built from, including the one pixel ring around the chunk
+        SolidMask solid_mask;
+
+        // what physics gets: our closed chains + the chains stitched across seams that we own
+        Polylines merged;
+        std::vector<u32> stitched_members; // chunks whose chains went into our stitched chains
+        std::vector<u32> seam_owners;      // chunks owning stitched chains made from our chains
+
+        // meshing scratch, only touched by the task meshing this chunk, kept to reuse its capacity
+        std::vector<Segment> segments;
+        std::vector<b2Vec2> points;
+        Polylines meshed;
+
         bool populated = false;
     };
     
+    static constexpr u32 MASK_WORDS_PER_ROW = (WIDTH * CHUNK_WIDTH + 63) / 64;
+    // 1 bit per pixel, bit `x % 64` of word (x / 64, y)
+    using SolidBits = Array2D<u64, MASK_WORDS_PER_ROW, HEIGHT * CHUNK_HEIGHT>;
+
     Array2D<ChunkCache, WIDTH, HEIGHT> m_chunk_cache;
+    Bitset2D<WIDTH, HEIGHT> m_collision_chunks; // chunks meshing was last asked for
+    Bitset2D<WIDTH, HEIGHT> m_urgent_chunks;    // of those, the ones awake bodies are in
     std::mutex m_cache_mutex;
 
-    std::vector<std::vector<b2Vec2>> mesh_world_parallel() {
-        std::vector<std::vector<b2Vec2>> all_chains;
-        std::vector<std::pair<u32, u32>> dirty_indices;
+    // double-buffered solid mask snapshots for pipelined meshing
+    SolidBits m_solid_snapshots[2];
+    u32 m_snapshot_back = 0;
+    bool m_snapshot_valid = false;
+    Bitset2D<WIDTH, HEIGHT> m_mesh_pending; // dirty at some capture, not meshed yet
+
+    // in-flight meshing pass
+    std::vector<std::pair<u32, u32>> m_meshing_dirty;
+    std::vector<std::pair<u32, u32>> m_meshing_changed;
+    std::vector<std::pair<u32, u32>> m_meshing_deferred; // out of budget, meshed in a later pass
+    std::chrono::steady_clock::time_point m_meshing_deadline;
+    std::atomic<i32> m_meshed_count{0};
+    ThreadPool m_mesh_thread_pool;
+
+    std::vector<b2Vec2> m_stitch_points; // stitch_from() scratch
+
+    // marks the chunks touched by any of the given world space (meters) regions
+    void chunks_overlapping(const std::vector<b2AABB>& regions, Bitset2D<WIDTH, HEIGHT>& chunks) const {
+        chunks.clear();
+        constexpr f32 chunk_w = CHUNK_WIDTH / PIXELS_PER_METER;
+        constexpr f32 chunk_h = CHUNK_HEIGHT / PIXELS_PER_METER;
+
+        for (const b2AABB& r : regions) {
+            const i32 min_cx = std::max(0, static_cast<i32>(std::floor(r.lowerBound.x / chunk_w)));
+            const i32 min_cy = std::max(0, static_cast<i32>(std::floor(r.lowerBound.y / chunk_h)));
+            const i32 max_cx = std::min(static_cast<i32>(WIDTH) - 1, static_cast<i32>(std::floor(r.upperBound.x / chunk_w)));
+            const i32 max_cy = std::min(static_cast<i32>(HEIGHT) - 1, static_cast<i32>(std::floor(r.upperBound.y / chunk_h)));
+
+            for (i32 cy = min_cy; cy <= max_cy; ++cy) {
+                for (i32 cx = min_cx; cx <= max_cx; ++cx) {
+                    chunks.set(cx, cy);
+                }
+            }
+        }
+    }
 
+    // Meshing is pipelined with the sand step:
+    //   capture_mesh_snapshot()   end of step N: copies the solid mask into the back buffer
+    //   begin_meshing()           start of step N+1: meshes the snapshot on the mesh pool...
+    //   update()                  ...while the sand step runs on the main pool
+    //   finish_meshing()          physics gets collision for the end of step N
+    // Meshing only ever reads the snapshot, so it never races the sand update.
+    // While nothing can collide, suspend_meshing() replaces all of it.
+
+    // copies the current solid mask (and the chunks dirtied since the last capture) for the next meshing pass
+    void capture_mesh_snapshot() {
+        m_solid_snapshots[m_snapshot_back].copy(m_solid_bits);
+
+        m_snapshot_back ^= 1;
+        m_snapshot_valid = true;
+
+        // chunks nothing could reach stay pending until something does
         for (u32 cy = 0; cy < HEIGHT; ++cy) {
             for (u32 cx = 0; cx < WIDTH; ++cx) {
-                if (m_dirty_chunks(cx, cy) || !m_chunk_cache(cx, cy).populated) {
-                    dirty_indices.push_back({cx, cy});
+                if (m_dirty_chunks(cx, cy)) {
+                    m_mesh_pending.set(cx, cy);
                 }
             }
         }
-        
-        if (!dirty_indices.empty()) {
-            for (const auto& [cx, cy] : dirty_indices) {
-                m_thread_pool.enqueue([this, cx, cy] {
-                    auto chains = mesh_chunk(cx, cy);
-                    
+        m_dirty_chunks.clear();
+    }
+
+    // skips capturing and meshing, dirty chunks keep piling up and the caches go stale
+    // the next begin_meshing() starts over from a fresh snapshot and catches up within its budget
+    void suspend_meshing() {
+        m_snapshot_valid = false;
+        g_stat_meshed_chunks.store(0, std::memory_order_relaxed);
+        g_stat_mesh_deferred.store(0, std::memory_order_relaxed);
+    }
+
+    // starts re-meshing pending chunks overlapping `collision_regions` on the mesh pool, returns immediately
+    // pending chunks nothing can reach keep their old collision until something approaches them
+    // chunks in `urgent_regions` go first, then the ones closest to `focus` (meters)
+    // chunks not started within `budget_ms` stay pending (with their old collision) for the next pass
+    void begin_meshing(const std::vector<b2AABB>& collision_regions, const std::vector<b2AABB>& urgent_regions, b2Vec2 focus, f32 budget_ms) {
+        m_meshing_dirty.clear();
+        m_meshing_changed.clear();
+        m_meshing_deferred.clear();
+        m_meshed_count.store(0, std::memory_order_relaxed);
+
+        if (!m_snapshot_valid) {
+            // first pass after clear() or suspend_meshing(), the sand step hasn't started so the mask is consistent
+            capture_mesh_snapshot();
+        }
+
+        Bitset2D<WIDTH, HEIGHT>& relevant = m_collision_chunks;
+        chunks_overlapping(collision_regions, relevant);
+        chunks_overlapping(urgent_regions, m_urgent_chunks);
+
+        for (u32 cy = 0; cy < HEIGHT; ++cy) {
+            for (u32 cx = 0; cx < WIDTH; ++cx) {
+                if (!relevant(cx, cy)) {
+                    continue;
+                }
+                if (m_mesh_pending(cx, cy) || !m_chunk_cache(cx, cy).populated) {
+                    m_meshing_dirty.push_back({cx, cy});
+                    m_mesh_pending.reset(cx, cy);
+                }
+            }
+        }
+
+        // the pool runs tasks in the order they're queued
+        const auto priority = [this, focus](const std::pair<u32, u32>& c) {
+            const f32 dx = (c.first + 0.5f) * (CHUNK_WIDTH / PIXELS_PER_METER) - focus.x;
+            const f32 dy = (c.second + 0.5f) * (CHUNK_HEIGHT / PIXELS_PER_METER) - focus.y;
+            return std::pair{!m_urgent_chunks(c.first, c.second), dx * dx + dy * dy};
+        };
+        std::sort(m_meshing_dirty.begin(), m_meshing_dirty.end(), [&](const auto& a, const auto& b) { return priority(a) < priority(b); });
+
+        m_meshing_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<i64>(budget_ms * 1000.0f));
+
+        // the snapshot just captured, capture_mesh_snapshot() won't touch it until finish_meshing()
+        const SolidBits* snapshot = &m_solid_snapshots[m_snapshot_back ^ 1];
+
+        for (u64 order = 0; order < m_meshing_dirty.size(); ++order) {
+            const auto [cx, cy] = m_meshing_dirty[order];
+            m_mesh_thread_pool.enqueue([this, cx, cy, order, snapshot] {
+                // a chunk already started runs to completion, so the pass overshoots by at most one chunk per worker
+                // the most important chunk always gets done, even with no budget at all
+                if (order > 0 && std::chrono::steady_clock::now() > m_meshing_deadline) {
+                    std::lock_guard<std::mutex> lock(m_cache_mutex);
+                    m_meshing_deferred.push_back({cx, cy});
+                    return;
+                }
+
+                // water sloshing or sand sliding over sand dirties a chunk without changing what is solid
+                SolidMask mask;
+                capture_solid_mask(*snapshot, cx, cy, mask);
+                {
                     std::lock_guard<std::mutex> lock(m_cache_mutex);
-                    m_chunk_cache(cx, cy).chains = std::move(chains);
-                    m_chunk_cache(cx, cy).populated = true;
-                });
+                    const ChunkCache& cache = m_chunk_cache(cx, cy);
+                    if (cache.populated && cache.solid_mask == mask) {
+                        return;
+                    }
+                }
+
+                ChunkCache& cache = m_chunk_cache(cx, cy);
+                mesh_chunk(*snapshot, cx, cy, cache);
+                m_meshed_count.fetch_add(1, std::memory_order_relaxed);
+                
+                std::lock_guard<std::mutex> lock(m_cache_mutex);
+                cache.solid_mask = mask;
+                if (cache.populated && cache.meshed == cache.chains) {
+                    return; // physics keeps the shapes it already has
+                }
+                std::swap(cache.chains, cache.meshed); // the old chains become the next scratch buffer
+                cache.populated = true;
+                m_meshing_changed.push_back({cx, cy});
+            });
+        }
+    }
+
+    // waits for begin_meshing(), returns the chunks whose merged chains changed
+    std::vector<std::pair<u32, u32>> finish_meshing() {
+        m_mesh_thread_pool.wait_all();
+
+        g_stat_meshed_chunks.store(m_meshed_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        g_stat_mesh_deferred.store(static_cast<i32>(m_meshing_deferred.size()), std::memory_order_relaxed);
+
+        for (const auto& [cx, cy] : m_meshing_deferred) {
+            m_mesh_pending.set(cx, cy);
+        }
+
+        std::vector<std::pair<u32, u32>>& changed_indices = m_meshing_changed;
+        // tasks finish in any order, keep stitching (and chain ownership) deterministic
+        std::sort(changed_indices.begin(), changed_indices.end());
+        return stitch_seams(changed_indices);
+    }
+
+    // int keys for stitching (avoid float precision issues)
+    struct PointKey {
+        i32 x, y;
+        bool operator<(const PointKey& o) const { return (x < o.x) || (x == o.x && y < o.y); }
+        bool operator==(const PointKey& o) const { return x == o.x && y == o.y; }
+    };
+
+    static PointKey to_key(b2Vec2 v) {
+        return { static_cast<i32>(std::round(v.x * PIXELS_PER_METER)), 
+                 static_cast<i32>(std::round(v.y * PIXELS_PER_METER)) };
+    }
+
+    ChunkCache& chunk_cache(u32 index) { return m_chunk_cache.data()[index]; }
+
+    // joins chains cut at chunk borders into continuous chains, but only around the chunks in `changed`
+    // returns every chunk whose `merged` chains were rebuilt (and need to be re-uploaded)
+    std::vector<std::pair<u32, u32>> stitch_seams(const std::vector<std::pair<u32, u32>>& changed) {
+        std::vector<u32> worklist;
+        std::vector<u32> rebuilt;
+
+        for (const auto& [cx, cy] : changed) {
+            const u32 index = chunk_index(cx, cy);
+            ChunkCache& cache = chunk_cache(index);
+
+            cache.chain_owner.assign(cache.chains.size(), NO_OWNER);
+            for (u64 i = 0; i < cache.chains.size(); ++i) {
+                if (cache.chains.is_loop(i)) {
+                    cache.chain_owner[i] = index; // closed chains never leave their chunk
+                }
             }
-            m_thread_pool.wait_all();
         }
-        
+
+        for (const auto& [cx, cy] : changed) {
+            const u32 index = chunk_index(cx, cy);
+
+            // the old chains are gone, and so is every stitched chain built from them
+            const std::vector<u32> owners = chunk_cache(index).seam_owners;
+            for (u32 owner : owners) {
+                invalidate_stitched(owner, worklist, rebuilt);
+            }
+            chunk_cache(index).seam_owners.clear();
+            invalidate_stitched(index, worklist, rebuilt);
+        }
+
+        for (u64 w = 0; w < worklist.size(); ++w) {
+            const u32 index = worklist[w];
+            for (u64 i = 0; i < chunk_cache(index).chains.size(); ++i) {
+                if (chunk_cache(index).chain_owner[i] == NO_OWNER) {
+                    stitch_from(index, static_cast<u32>(i), worklist, rebuilt);
+                }
+            }
+        }
+
+        std::sort(rebuilt.begin(), rebuilt.end());
+        rebuilt.erase(std::unique(rebuilt.begin(), rebuilt.end()), rebuilt.end());
+
+        std::vector<std::pair<u32, u32>> result;
+        result.reserve(rebuilt.size());
+        for (u32 index : rebuilt) {
+            result.push_back({index % WIDTH, index / WIDTH});
+        }
+        return result;
+    }
+
+    // drops every stitched chain `owner` has, its pieces become free to be stitched again
+    void invalidate_stitched(u32 owner, std::vector<u32>& worklist, std::vector<u32>& rebuilt) {
+        ChunkCache& owner_cache = chunk_cache(owner);
+
+        for (u32 member : owner_cache.stitched_members) {
+            ChunkCache& member_cache = chunk_cache(member);
+            for (u64 i = 0; i < member_cache.chains.size(); ++i) {
+                if (member_cache.chain_owner[i] == owner && !member_cache.chains.is_loop(i)) {
+                    member_cache.chain_owner[i] = NO_OWNER;
+                }
+            }
+            std::erase(member_cache.seam_owners, owner);
+            worklist.push_back(member);
+        }
+        owner_cache.stitched_members.clear();
+
+        // keep only our own closed chains
+        owner_cache.merged.clear();
+        for (u64 i = 0; i < owner_cache.chains.size(); ++i) {
+            if (owner_cache.chains.is_loop(i)) {
+                owner_cache.merged.append(owner_cache.chains, i);
+            }
+        }
+
+        worklist.push_back(owner);
+        rebuilt.push_back(owner);
+    }
+
+    struct ChainRef {
+        u32 chunk;
+        u32 chain;
+        bool operator==(const ChainRef& o) const { return chunk == o.chunk && chain == o.chain; }
+    };
+
+    // finds an open chain starting (or ending, if `at_end`) at `key`
+    // chains stitched by anyone but `current_owner` are freed first, the new connection replaces theirs
+    bool find_open_chain(PointKey key, bool at_end, u32 current_owner, ChainRef& out, std::vector<u32>& worklist, std::vector<u32>& rebuilt) {
+        // a point on a seam is shared by up to 4 chunks
+        const i32 cx_hi = key.x / static_cast<i32>(CHUNK_WIDTH);
+        const i32 cy_hi = key.y / static_cast<i32>(CHUNK_HEIGHT);
+        const i32 cx_lo = (key.x % CHUNK_WIDTH == 0) ? cx_hi - 1 : cx_hi;
+        const i32 cy_lo = (key.y % CHUNK_HEIGHT == 0) ? cy_hi - 1 : cy_hi;
+
+        for (i32 cy = std::max(cy_lo, 0); cy <= std::min(cy_hi, static_cast<i32>(HEIGHT) - 1); ++cy) {
+            for (i32 cx = std::max(cx_lo, 0); cx <= std::min(cx_hi, static_cast<i32>(WIDTH) - 1); ++cx) {
+                const u32 index = chunk_index(cx, cy);
+                ChunkCache& cache = chunk_cache(index);
+
+                for (u64 i = 0; i < cache.chains.size(); ++i) {
+                    if (cache.chains.is_loop(i) || !(to_key(at_end ? cache.chains.back(i) : cache.chains.front(i)) == key)) {
+                        continue;
+                    }
+                    if (cache.chain_owner[i] != NO_OWNER && cache.chain_owner[i] != current_owner) {
+                        invalidate_stitched(cache.chain_owner[i], worklist, rebuilt);
+                    }
+                    out = {index, static_cast<u32>(i)};
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void stitch_from(u32 chunk, u32 chain, std::vector<u32>& worklist, std::vector<u32>& rebuilt) {
+        const auto chain_at = [this](ChainRef r) { return chunk_cache(r.chunk).chains[r.chain]; };
+        const auto owner_of = [this](ChainRef r) -> u32& { return chunk_cache(r.chunk).chain_owner[r.chain]; };
+
+        // walk back to where the contour starts, so it isn't split in the middle
+        ChainRef head = {chunk, chain};
+        std::vector<ChainRef> visited = {head};
+        while (true) {
+            ChainRef prev;
+            if (!find_open_chain(to_key(chain_at(head).front()), true, NO_OWNER, prev, worklist, rebuilt)) {
+                break;
+            }
+            // back at the start (a loop), or branching contours cycling without reaching it
+            if (std::find(visited.begin(), visited.end(), prev) != visited.end()) {
+                break;
+            }
+            visited.push_back(prev);
+            head = prev;
+        }
+
+        const u32 owner = head.chunk;
+        ChunkCache& owner_cache = chunk_cache(owner);
+
+        std::vector<b2Vec2>& points = m_stitch_points;
+        points.assign(chain_at(head).begin(), chain_at(head).end());
+        std::vector<u32> members = {head.chunk};
+        owner_of(head) = owner;
+
+        bool loop = false;
+        ChainRef tip = head;
+        while (true) {
+            ChainRef next;
+            if (!find_open_chain(to_key(chain_at(tip).back()), false, owner, next, worklist, rebuilt)) {
+                break; // dead end
+            }
+            if (owner_of(next) != NO_OWNER) {
+                loop = next == head;
+                break;
+            }
+            owner_of(next) = owner;
+            const auto next_points = chain_at(next);
+            points.insert(points.end(), next_points.begin() + 1, next_points.end());
+            members.push_back(next.chunk);
+            tip = next;
+        }
+        if (loop) {
+            points.pop_back(); // the last piece ends where the head starts
+        }
+
+        for (u32 member : members) {
+            ChunkCache& member_cache = chunk_cache(member);
+            if (std::find(member_cache.seam_owners.begin(), member_cache.seam_owners.end(), owner) == member_cache.seam_owners.end()) {
+                member_cache.seam_owners.push_back(owner);
+            }
+            if (std::find(owner_cache.stitched_members.begin(), owner_cache.stitched_members.end(), member) == owner_cache.stitched_members.end()) {
+                owner_cache.stitched_members.push_back(member);
+            }
+        }
+
+        if (members.size() > 1) {
+            append_simplified(points, loop, SIMPLIFICATION_EPSILON, owner_cache.merged);
+        } else {
+            owner_cache.merged.append(points, 0);
+        }
+        rebuilt.push_back(owner);
+    }
+
+    u64 chain_count() const {
+        u64 count = 0;
         for (const auto& cache : m_chunk_cache) {
-            all_chains.insert(all_chains.end(), cache.chains.begin(), cache.chains.end());
+            count += cache.merged.size();
         }
-        
-        return all_chains;
+        return count;
     }
     
-    struct Segment {
-        b2Vec2 p1, p2;
-    };
+    // solid pattern of the chunk and its one pixel border ring, everything `mesh_chunk` looks at
+    static void capture_solid_mask(const SolidBits& bits, u32 cx, u32 cy, SolidMask& mask) {
+        const u32 w0 = cx * CHUNK_WORDS;
+        const u32 y0 = cy * CHUNK_HEIGHT;
+
+        for (u32 r = 0; r < CHUNK_HEIGHT + 2; ++r) {
+            const i32 y = static_cast<i32>(y0 + r) - 1;
+            for (u32 w = 0; w < CHUNK_WORDS; ++w) {
+                mask.rows[r * CHUNK_WORDS + w] = row_word(bits, w0 + w, y);
+            }
+        }
+        for (u32 r = 0; r < CHUNK_HEIGHT; ++r) {
+            mask.left[r] = (row_word(bits, static_cast<i32>(w0) - 1, y0 + r) >> 63) & 1;
+            mask.right[r] = row_word(bits, w0 + CHUNK_WORDS, y0 + r) & 1;
+        }
+    }
+
+    // out of bounds words are empty
+    static u64 row_word(const SolidBits& bits, i32 w, i32 y) {
+        if (w < 0 || w >= static_cast<i32>(MASK_WORDS_PER_ROW) || y < 0 || y >= static_cast<i32>(HEIGHT * CHUNK_HEIGHT)) {
+            return 0;
+        }
+        return bits(w, y);
+    }
 
     // generates a list of line segments that form the boundaries of solid particles in a chunk
-    std::vector<std::vector<b2Vec2>> mesh_chunk(u32 cx, u32 cy) {
-        std::vector<Segment> segments;
+    // boundaries come out of the packed mask 64 pixels at a time, only set bits are visited
+    // the chains end up in `cache.meshed`
+    void mesh_chunk(const SolidBits& bits, u32 cx, u32 cy, ChunkCache& cache) {
+        std::vector<Segment>& segments = cache.segments;
+        segments.clear();
         constexpr f32 scale = 1.0f / PIXELS_PER_METER;
         
-        const u32 start_x = cx * CHUNK_WIDTH;
-        const u32 start_y = cy * CHUNK_HEIGHT;
-        const u32 end_x = start_x + CHUNK_WIDTH;
-        const u32 end_y = start_y + CHUNK_HEIGHT;
+        const i32 w0 = cx * CHUNK_WORDS;
+        const i32 start_y = cy * CHUNK_HEIGHT;
+        const i32 end_y = start_y + CHUNK_HEIGHT;
         
-        for (u32 y = start_y; y < end_y; ++y) {
-            for (u32 x = start_x; x < end_x; ++x) {
-                // cast to i32 for boundary checks
-                const i32 world_x = x;
-                const i32 world_y = y;
-                
-                // solid pixels generate boundaries
-                if (!is_static_solid(world_x, world_y)) {
+        for (i32 y = start_y; y < end_y; ++y) {
+            for (i32 w = w0; w < w0 + static_cast<i32>(CHUNK_WORDS); ++w) {
+                const u64 cur = row_word(bits, w, y);
+                if (cur == 0) {
                     continue;
                 }
-                
-                // check 4 GLOBAL neighbors. If Air/Bound, add edge.
-                
+
+                // neighbour solidity shifted into place: bit b of `left` = is pixel b - 1 solid, etc.
+                const u64 left = (cur << 1) | (row_word(bits, w - 1, y) >> 63);
+                const u64 right = (cur >> 1) | (row_word(bits, w + 1, y) << 63);
+
+                // solid pixels with a non-solid neighbour generate an edge
+                const u64 top_edges = cur & ~row_word(bits, w, y - 1);
+                const u64 bottom_edges = cur & ~row_word(bits, w, y + 1);
+                const u64 left_edges = cur & ~left;
+                const u64 right_edges = cur & ~right;
+
                 // coords in meters
-                const f32 x0 = world_x * scale;
-                const f32 x1 = (world_x + 1) * scale;
-                const f32 y0 = world_y * scale;
-                const f32 y1 = (world_y + 1) * scale;
-                
-                // top
-                if (!is_static_solid(world_x, world_y - 1)) {
-                    segments.push_back({{x1, y0}, {x0, y0}});
-                }
-                // bottom
-                if (!is_static_solid(world_x, world_y + 1)) {
-                    segments.push_back({{x0, y1}, {x1, y1}});
-                }
-                // left
-                if (!is_static_solid(world_x - 1, world_y)) {
-                    segments.push_back({{x0, y0}, {x0, y1}});
-                }
-                // right
-                if (!is_static_solid(world_x + 1, world_y)) {
-                    segments.push_back({{x1, y1}, {x1, y0}});
-                }
+                const f32 y0 = y * scale;
+                const f32 y1 = (y + 1) * scale;
+
+                auto for_each_bit = [&](u64 edges, auto&& emit) {
+                    while (edges) {
+                        const i32 x = w * 64 + std::countr_zero(edges);
+                        emit(x * scale, (x + 1) * scale);
+                        edges &= edges - 1;
+                    }
+                };
+
+                for_each_bit(top_edges, [&](f32 x0, f32 x1) { segments.push_back({{x1, y0}, {x0, y0}}); });
+                for_each_bit(bottom_edges, [&](f32 x0, f32 x1) { segments.push_back({{x0, y1}, {x1, y1}}); });
+                for_each_bit(left_edges, [&](f32 x0, f32 x1) { segments.push_back({{x0, y0}, {x0, y1}}); });
+                for_each_bit(right_edges, [&](f32 x0, f32 x1) { segments.push_back({{x1, y1}, {x1, y0}}); });
             }
         }
         
-        return stitch_segments(segments);
+        stitch_segments(segments, cache.points, cache.meshed);
     }
 
-    // stitches line segments into continuous chains (polygons)
-    std::vector<std::vector<b2Vec2>> stitch_segments(const std::vector<Segment>& segments) {
+    // stitches line segments into continuous chains (polygons), `chain` is scratch
+    void stitch_segments(const std::vector<Segment>& segments, std::vector<b2Vec2>& chain, Polylines& chains) {
+        chains.clear();
         if (segments.empty()) {
-            return {};
+            return;
         }
 
-        // int keys for stitching (avoid float precision issues)
-        struct PointKey {
-            i32 x, y;
-            bool operator<(const PointKey& o) const { return (x < o.x) || (x == o.x && y < o.y); }
-        };
-        
-        auto to_key = [](b2Vec2 v) -> PointKey {
-            return { static_cast<i32>(std::round(v.x * PIXELS_PER_METER)), 
-                     static_cast<i32>(std::round(v.y * PIXELS_PER_METER)) };
-        };
-        
         // adjacent if they share a vertex (same coords)
         std::map<PointKey, std::vector<i32>> adj;
         for(i32 i = 0; i < segments.size(); ++i) {
             adj[to_key(segments[i].p1)].push_back(i);
         }
         
+        // start from segments nothing leads into first, so contours leaving the chunk come out in one piece
+        std::map<PointKey, i32> incoming;
+        for(i32 i = 0; i < segments.size(); ++i) {
+            ++incoming[to_key(segments[i].p2)];
+        }
+        std::vector<i32> order;
+        order.reserve(segments.size());
+        for(i32 i = 0; i < segments.size(); ++i) {
+            if (!incoming.contains(to_key(segments[i].p1))) {
+                order.push_back(i);
+            }
+        }
+        for(i32 i = 0; i < segments.size(); ++i) {
+            if (incoming.contains(to_key(segments[i].p1))) {
+                order.push_back(i);
+            }
+        }
+
         std::vector<bool> used(segments.size(), false);
-        std::vector<std::vector<b2Vec2>> chains;
         
         // stitch segments into chains
-        for(i32 i = 0; i < segments.size(); ++i) {
+        for(i32 i : order) {
             if (used[i]) {
                 continue;
             }
             
-            std::vector<b2Vec2> chain;
-            
+            chain.clear();
             chain.push_back(segments[i].p1);
             chain.push_back(segments[i].p2);
 
@@ -405,50 +1235,333 @@ public:
                 }
             }
             
-            if (chain.size() > 1) {
-                std::vector<b2Vec2> sim = simplify_collinear(chain, SIMPLIFICATION_EPSILON);
-                if (sim.size() > 1) {
-                    chains.push_back(sim);
-                }
+            // back where it started: a loop, the closing point isn't stored twice
+            const bool loop = chain.size() > 2 && to_key(chain.front()) == to_key(chain.back());
+            if (loop) {
+                chain.pop_back();
             }
+            append_simplified(chain, loop, SIMPLIFICATION_EPSILON, chains);
         }
-
-        return chains;
     }
-    
-    // remove points that are collinear
-    static std::vector<b2Vec2> simplify_collinear(const std::vector<b2Vec2>& points, f32 epsilon) {
-        if (points.size() < 3) {
-            return points;
-        }
+
+    // `curr` adds nothing between `prev` and `next`
+    static bool is_collinear(b2Vec2 prev, b2Vec2 curr, b2Vec2 next, f32 epsilon) {
+        const f32 dx1 = curr.x - prev.x;
+        const f32 dy1 = curr.y - prev.y;
+        const f32 dx2 = next.x - curr.x;
+        const f32 dy2 = next.y - curr.y;
         
-        std::vector<b2Vec2> result;
-        result.push_back(points[0]);
+        const f32 cross = dx1 * dy2 - dy1 * dx2;
+        const f32 dot = dx1 * dx2 + dy1 * dy2;
         
-        for (u64 i = 1; i < points.size() - 1; ++i) {
-            const b2Vec2& prev = result.back();
-            const b2Vec2& curr = points[i];
-            const b2Vec2& next = points[i + 1];
-            
-            const f32 dx1 = curr.x - prev.x;
-            const f32 dy1 = curr.y - prev.y;
-            const f32 dx2 = next.x - curr.x;
-            const f32 dy2 = next.y - curr.y;
-            
-            const f32 cross = dx1 * dy2 - dy1 * dx2;
-            const f32 dot = dx1 * dx2 + dy1 * dy2;
-            
-            // if cross product is close to 0, points are collinear
-            // if dot product is positive, points are in the same direction
-            if (std::abs(cross) < epsilon && dot > 0) {
+        // if cross product is close to 0, points are collinear
+        // if dot product is positive, points are in the same direction
+        return std::abs(cross) < epsilon && dot > 0;
+    }
+
+    // appends `points` to `out` without the collinear ones
+    static void append_simplified(std::span<const b2Vec2> points, bool loop, f32 epsilon, Polylines& out) {
+        const u64 n = points.size();
+        const u8 flags = loop ? Polylines::LOOP : 0;
+        if (n < 3) {
+            out.append(points, flags);
+            return;
+        }
+
+        // loops wrap around, start on a corner so it is kept
+        u64 start = 0;
+        if (loop) {
+            while (start < n && is_collinear(points[(start + n - 1) % n], points[start], points[(start + 1) % n], epsilon)) {
+                ++start;
+            }
+            if (start == n) {
+                out.append(points, flags); // degenerate, no corners
+                return;
+            }
+        }
+
+        out.push_point(points[start]);
+        b2Vec2 prev = points[start];
+        const u64 last = loop ? n : n - 1; // open chains always keep their end
+        for (u64 k = 1; k < last; ++k) {
+            const b2Vec2 curr = points[(start + k) % n];
+            const b2Vec2 next = points[(start + k + 1) % n];
+            if (is_collinear(prev, curr, next, epsilon)) {
                 continue;
             }
-            
-            result.push_back(curr);
+            out.push_point(curr);
+            prev = curr;
+        }
+        if (!loop) {
+            out.push_point(points[n - 1]);
+        }
+        out.end_line(flags);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Floating stone
+    // Anchoring pixels are labeled per chunk (4-connected), the labels are joined across seams,
+    // and every component not reaching the world border is an island.
+    // Only chunks whose anchoring pixels changed get relabeled, the seam join is cheap enough to redo.
+
+    struct PixelRect {
+        i32 x, y, w, h;
+    };
+
+    struct Island {
+        std::vector<PixelRect> rects; // cover the island exactly, without overlapping
+        u32 pixel_count = 0;
+        i32 min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN; // inclusive
+    };
+
+    static constexpr u32 MIN_ISLAND_PIXELS = 8; // smaller crumbs stay put as terrain
+
+    struct IslandChunk {
+        std::array<u16, CHUNK_WIDTH * CHUNK_HEIGHT> labels; // 0 = not anchoring, else 1..count
+        u16 count = 0;
+        // labeling scratch
+        std::vector<u16> parent;
+        std::vector<u16> compact;
+    };
+
+    Array2D<IslandChunk, WIDTH, HEIGHT> m_island_chunks;
+    std::vector<u32> m_island_base;   // per chunk index: global label of its local label 1
+    std::vector<u32> m_island_parent; // seam join union-find over global labels, 0 = the world border
+    std::vector<i32> m_island_index;  // per root global label: index into the found islands
+    
+    // relabels the chunks whose anchoring pixels changed (on the world pool) and collects islands
+    // of at least MIN_ISLAND_PIXELS into `islands`, returns whether there are any
+    // must not overlap update(), labels are read straight from the particles
+    bool find_islands(std::vector<Island>& islands) {
+        islands.clear();
+        if (m_island_dirty.none()) {
+            return false; // nothing anchoring changed, so no new islands either
+        }
+
+        for (u32 cy = 0; cy < HEIGHT; ++cy) {
+            for (u32 cx = 0; cx < WIDTH; ++cx) {
+                if (m_island_dirty(cx, cy)) {
+                    m_thread_pool.enqueue([this, cx, cy] { label_chunk(cx, cy); });
+                }
+            }
+        }
+        m_thread_pool.wait_all();
+        m_island_dirty.clear();
+
+        join_island_labels();
+        collect_islands(islands);
+
+        std::erase_if(islands, [](const Island& island) { return island.pixel_count < MIN_ISLAND_PIXELS; });
+        return !islands.empty();
+    }
+
+    // two pass union-find labeling of one chunk
+    void label_chunk(u32 cx, u32 cy) {
+        IslandChunk& chunk = m_island_chunks(cx, cy);
+        std::vector<u16>& parent = chunk.parent;
+        parent.assign(1, 0);
+
+        const auto find = [&parent](u16 a) {
+            while (parent[a] != a) {
+                parent[a] = parent[parent[a]];
+                a = parent[a];
+            }
+            return a;
+        };
+
+        const u32 x0 = cx * CHUNK_WIDTH;
+        const u32 y0 = cy * CHUNK_HEIGHT;
+
+        for (u32 ly = 0; ly < CHUNK_HEIGHT; ++ly) {
+            for (u32 lx = 0; lx < CHUNK_WIDTH; ++lx) {
+                const u32 i = ly * CHUNK_WIDTH + lx;
+                u16& label = chunk.labels[i];
+                if (!is_anchoring(x0 + lx, y0 + ly)) {
+                    label = 0;
+                    continue;
+                }
+
+                const u16 left = lx > 0 ? chunk.labels[i - 1] : 0;
+                const u16 up = ly > 0 ? chunk.labels[i - CHUNK_WIDTH] : 0;
+                if (left == 0 && up == 0) {
+                    label = static_cast<u16>(parent.size());
+                    parent.push_back(label);
+                } else if (left != 0 && up != 0) {
+                    const u16 a = find(left);
+                    const u16 b = find(up);
+                    label = std::min(a, b);
+                    parent[std::max(a, b)] = label;
+                } else {
+                    label = left != 0 ? left : up;
+                }
+            }
+        }
+
+        // roots get consecutive labels
+        std::vector<u16>& compact = chunk.compact;
+        compact.assign(parent.size(), 0);
+        u16 count = 0;
+        for (u16 l = 1; l < parent.size(); ++l) {
+            if (find(l) == l) {
+                compact[l] = ++count;
+            }
+        }
+        for (u16& label : chunk.labels) {
+            if (label != 0) {
+                label = compact[find(label)];
+            }
+        }
+        chunk.count = count;
+    }
+
+    u32 find_island_root(u32 a) {
+        std::vector<u32>& parent = m_island_parent;
+        while (parent[a] != a) {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+        return a;
+    }
+
+    void unite_islands(u32 a, u32 b) {
+        a = find_island_root(a);
+        b = find_island_root(b);
+        if (a != b) {
+            // the border (0) always stays a root
+            m_island_parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    // global label of the pixel, 0 if not anchoring (which is also the border label, check the pixel first)
+    u32 island_label(u32 x, u32 y) const {
+        const u32 cx = x / CHUNK_WIDTH;
+        const u32 cy = y / CHUNK_HEIGHT;
+        const u16 local = m_island_chunks(cx, cy).labels[(y % CHUNK_HEIGHT) * CHUNK_WIDTH + x % CHUNK_WIDTH];
+        return local == 0 ? 0 : m_island_base[chunk_index(cx, cy)] + local - 1;
+    }
+
+    void join_island_labels() {
+        m_island_base.resize(WIDTH * HEIGHT);
+        u32 total = 1;
+        for (u32 i = 0; i < WIDTH * HEIGHT; ++i) {
+            m_island_base[i] = total;
+            total += m_island_chunks.data()[i].count;
+        }
+        m_island_parent.resize(total);
+        for (u32 i = 0; i < total; ++i) {
+            m_island_parent[i] = i;
+        }
+
+        const u32 w = width();
+        const u32 h = height();
+
+        const auto join = [this](u32 ax, u32 ay, u32 bx, u32 by) {
+            const u32 a = island_label(ax, ay);
+            const u32 b = island_label(bx, by);
+            if (a != 0 && b != 0) {
+                unite_islands(a, b);
+            }
+        };
+
+        // seams between chunks
+        for (u32 x = CHUNK_WIDTH; x < w; x += CHUNK_WIDTH) {
+            for (u32 y = 0; y < h; ++y) {
+                join(x - 1, y, x, y);
+            }
+        }
+        for (u32 y = CHUNK_HEIGHT; y < h; y += CHUNK_HEIGHT) {
+            for (u32 x = 0; x < w; ++x) {
+                join(x, y - 1, x, y);
+            }
+        }
+
+        // everything reaching the world border is anchored
+        const auto anchor = [this](u32 x, u32 y) {
+            const u32 label = island_label(x, y);
+            if (label != 0) {
+                unite_islands(0, label);
+            }
+        };
+        for (u32 x = 0; x < w; ++x) {
+            anchor(x, 0);
+            anchor(x, h - 1);
+        }
+        for (u32 y = 0; y < h; ++y) {
+            anchor(0, y);
+            anchor(w - 1, y);
+        }
+    }
+
+    // greedy rectangles: horizontal runs, stacked while consecutive rows have the exact same run
+    void collect_islands(std::vector<Island>& islands) {
+        bool any = false;
+        for (u32 label = 1; label < m_island_parent.size(); ++label) {
+            if (find_island_root(label) != 0) {
+                any = true;
+                break;
+            }
+        }
+        if (!any) {
+            return;
+        }
+
+        m_island_index.assign(m_island_parent.size(), -1);
+
+        struct Run {
+            i32 x0, x1; // inclusive
+            i32 island;
+            u32 rect;
+        };
+        std::vector<Run> prev, curr;
+
+        const i32 w = static_cast<i32>(width());
+        const i32 h = static_cast<i32>(height());
+
+        for (i32 y = 0; y < h; ++y) {
+            curr.clear();
+            u64 p = 0; // walks `prev`, runs are sorted by x
+            for (i32 x = 0; x < w; ++x) {
+                if (!is_anchoring(x, y)) {
+                    continue;
+                }
+                const u32 root = find_island_root(island_label(x, y));
+                const i32 x0 = x;
+                while (x + 1 < w && is_anchoring(x + 1, y)) {
+                    ++x; // horizontal neighbours are connected, same root
+                }
+                if (root == 0) {
+                    continue;
+                }
+
+                i32& index = m_island_index[root];
+                if (index < 0) {
+                    index = static_cast<i32>(islands.size());
+                    islands.emplace_back();
+                }
+                Island& island = islands[index];
+
+                // a run right above with the same extent is necessarily the same island
+                while (p < prev.size() && prev[p].x1 < x0) {
+                    ++p;
+                }
+                u32 rect;
+                if (p < prev.size() && prev[p].x0 == x0 && prev[p].x1 == x && prev[p].island == index) {
+                    rect = prev[p].rect;
+                    ++island.rects[rect].h;
+                } else {
+                    rect = static_cast<u32>(island.rects.size());
+                    island.rects.push_back({x0, y, x - x0 + 1, 1});
+                }
+                curr.push_back({x0, x, index, rect});
+
+                island.pixel_count += x - x0 + 1;
+                island.min_x = std::min(island.min_x, x0);
+                island.max_x = std::max(island.max_x, x);
+                island.min_y = std::min(island.min_y, y);
+                island.max_y = std::max(island.max_y, y);
+            }
+            std::swap(prev, curr);
         }
-        
-        result.push_back(points.back());
-        return result;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -487,7 +1600,6 @@ public:
     void update() {
         g_sim_step_count++;
         m_updated_particles.clear();
-        m_dirty_chunks.fill(); 
 
         const bool flip_chunks_x = g_sim_step_count & 1; // every 1
         const bool flip_chunks_y = (g_sim_step_count >> 1) & 1; // every 2
@@ -520,58 +1632,100 @@ public:
         }
     }
 
-    // Write directly to GPU texture buffer
-    void renderToTexture(SDL_Texture* texture) {
-        void* pixels = nullptr;
-        i32 pitch_bytes = 0;
-
-        if (!SDL_LockTexture(texture, nullptr, &pixels, &pitch_bytes)) {
-            Logging::log_warning("Failed to lock texture: ", SDL_GetError());
-            return;
-        }
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Snapshots
+    // The material plane as of the end of a step, for the main thread to draw (or look at) without a lock.
+    // Each of the three buffers only copies the chunks whose version moved on since it was last published.
 
-        const u32 width = WIDTH * CHUNK_WIDTH;
-        const u32 height = HEIGHT * CHUNK_HEIGHT;
-        const u32 pitch = pitch_bytes / sizeof(u32);
+    struct Snapshot {
+        Array2D<ParticleID, WIDTH * CHUNK_WIDTH, HEIGHT * CHUNK_HEIGHT> materials;
+        Array2D<u32, WIDTH, HEIGHT> versions; // of each chunk's copy
+    };
 
-        u32* dst = static_cast<u32*>(pixels);
+    // simulation thread, at the end of a step
+    void publish_snapshot() {
+        for (u32 cy = 0; cy < HEIGHT; ++cy) {
+            for (u32 cx = 0; cx < WIDTH; ++cx) {
+                if (m_chunk_changed(cx, cy)) {
+                    m_chunk_changed(cx, cy) = 0;
+                    ++m_chunk_versions(cx, cy);
+                }
+            }
+        }
 
-        const u32 workers = m_thread_pool.thread_count();
-        const u32 rows_per_task = (height + workers - 1) / workers;
+        Snapshot& back = m_snapshots.back();
+        for (u32 cy = 0; cy < HEIGHT; ++cy) {
+            for (u32 cx = 0; cx < WIDTH; ++cx) {
+                if (back.versions(cx, cy) == m_chunk_versions(cx, cy)) {
+                    continue;
+                }
+                back.versions(cx, cy) = m_chunk_versions(cx, cy);
+                for (u32 y = cy * CHUNK_HEIGHT; y < (cy + 1) * CHUNK_HEIGHT; ++y) {
+                    for (u32 x = cx * CHUNK_WIDTH; x < (cx + 1) * CHUNK_WIDTH; ++x) {
+                        back.materials(x, y) = m_particles(x, y).id;
+                    }
+                }
+            }
+        }
+        m_snapshots.publish();
+    }
 
-        for (u32 i = 0; i < workers; ++i) {
-            const u32 y_start = i * rows_per_task;
-            const u32 y_end = std::min(y_start + rows_per_task, height);
+    // one reader thread: the latest published snapshot, untouched until its next call
+    const Snapshot& snapshot() { return m_snapshots.front(); }
 
-            if (y_start >= y_end) {
-                break;
-            }
+    // brings `texture` up to date with the latest snapshot, uploading only the chunks that changed since the
+    // last call (a still world uploads nothing); runs of changed chunks along a row go up as one rect
+    // same reader thread as snapshot()
+    void renderToTexture(SDL_Texture* texture) {
+        const Snapshot& snap = snapshot();
 
-            m_thread_pool.enqueue([=, this] {
-                for (u32 y = y_start; y < y_end; ++y) {
-                    u32* row = dst + y * width;
+        for (u32 cy = 0; cy < HEIGHT; ++cy) {
+            u32 cx = 0;
+            while (cx < WIDTH) {
+                if (m_uploaded_versions(cx, cy) == snap.versions(cx, cy)) {
+                    ++cx;
+                    continue;
+                }
+                const u32 first = cx;
+                while (cx < WIDTH && m_uploaded_versions(cx, cy) != snap.versions(cx, cy)) {
+                    ++cx;
+                }
 
-                    for (u32 x = 0; x < width; ++x) {
+                const u32 x0 = first * CHUNK_WIDTH;
+                const u32 run_width = (cx - first) * CHUNK_WIDTH;
+                m_texture_staging.resize(static_cast<u64>(run_width) * CHUNK_HEIGHT);
+                for (u32 y = 0; y < CHUNK_HEIGHT; ++y) {
+                    u32* row = m_texture_staging.data() + static_cast<u64>(y) * run_width;
+                    for (u32 x = 0; x < run_width; ++x) {
                         // TODO: maybe add some variation based on coords?
-                        row[x] = particle_colors_u32[
-                            static_cast<u32>(m_particles(x, y).id)
-                        ];
+                        row[x] = particle_colors_u32[static_cast<u32>(snap.materials(x0 + x, cy * CHUNK_HEIGHT + y))];
                     }
                 }
-            });
-        }
 
-        m_thread_pool.wait_all();
-        SDL_UnlockTexture(texture);
+                const SDL_Rect rect = {static_cast<i32>(x0), static_cast<i32>(cy * CHUNK_HEIGHT), static_cast<i32>(run_width), static_cast<i32>(CHUNK_HEIGHT)};
+                if (!SDL_UpdateTexture(texture, &rect, m_texture_staging.data(), static_cast<i32>(run_width * sizeof(u32)))) {
+                    Logging::log_warning("Failed to update texture: ", SDL_GetError());
+                    continue; // versions left as they were, tried again next frame
+                }
+                for (u32 x = first; x < cx; ++x) {
+                    m_uploaded_versions(x, cy) = snap.versions(x, cy);
+                }
+            }
+        }
     }
 
     u32 width() const { return WIDTH * CHUNK_WIDTH; }
     u32 height() const { return HEIGHT * CHUNK_HEIGHT; }
 
+    u32 chunk_width() const { return CHUNK_WIDTH; }
+    u32 chunk_height() const { return CHUNK_HEIGHT; }
+    u32 chunk_count() const { return WIDTH * HEIGHT; }
+    u32 chunk_index(u32 chunk_x, u32 chunk_y) const { return chunk_y * WIDTH + chunk_x; }
+
     void setParticle(u32 x, u32 y, ParticleID id) {
         // avoid overwriting the stone border
         if (x > 0 && x < width() - 1 && y > 0 && y < height() - 1) {
-            m_particles(x, y).id = id;
+            set_particle_id(x, y, id);
             mark_chunk_dirty(x, y);
         }
     }
@@ -584,8 +1738,16 @@ public:
         return m_particles(x, y);
     }
 
+    BodyID body_id_at(u32 x, u32 y) const {
+        return m_body_ids(x, y);
+    }
+
+    // idle outside of `update` and `find_islands`, other simulation-thread work can borrow it
+    ThreadPool& thread_pool() { return m_thread_pool; }
+
     void clear() {
-        m_particles.fill({ParticleID::AIR, 0, 0});  // id, body_id, lifetime
+        m_particles.fill({ParticleID::AIR, 0});  // id, lifetime
+        m_body_ids.clear();
 
         // stone border
         for (u32 i = 0; i < WIDTH * CHUNK_WIDTH; ++i) {
@@ -596,20 +1758,155 @@ public:
             m_particles(WIDTH * CHUNK_WIDTH - 1, i).id = ParticleID::STONE;
             m_particles(0, i).id = ParticleID::STONE;
         }
+
+        m_solid_bits.clear();
+        m_tile_counts.clear();
+        m_chunk_counts.clear();
+        for (u32 y = 0; y < HEIGHT * CHUNK_HEIGHT; ++y) {
+            for (u32 x = 0; x < WIDTH * CHUNK_WIDTH; ++x) {
+                if (is_static_solid(m_particles(x, y).id, m_body_ids(x, y))) {
+                    m_solid_bits(x / 64, y) |= u64(1) << (x % 64);
+                }
+                if (m_particles(x, y).id != ParticleID::AIR) {
+                    ++m_tile_counts(x / TILE_SIZE, y / TILE_SIZE);
+                    ++m_chunk_counts(x / CHUNK_WIDTH, y / CHUNK_HEIGHT);
+                }
+            }
+        }
         
         for (auto& cache : m_chunk_cache) {
             cache.populated = false;
             cache.chains.clear();
+            cache.chain_owner.clear();
+            cache.merged.clear();
+            cache.stitched_members.clear();
+            cache.seam_owners.clear();
         }
-        m_dirty_chunks.fill();
+        m_dirty_chunks.fill(1);
+        m_chunk_changed.fill(1);
+        m_mesh_pending.fill();
+        m_snapshot_valid = false;
+        m_island_dirty.fill();
         m_updated_particles.clear();
     }
 
 private:
     Array2D<Particle, WIDTH * CHUNK_WIDTH, HEIGHT * CHUNK_HEIGHT> m_particles;
+    Array2D<BodyID, WIDTH * CHUNK_WIDTH, HEIGHT * CHUNK_HEIGHT> m_body_ids;
+    Array2D<u16, WIDTH * CHUNK_WIDTH / TILE_SIZE, HEIGHT * CHUNK_HEIGHT / TILE_SIZE> m_tile_counts;
+    Array2D<u16, WIDTH, HEIGHT> m_chunk_counts;
+    SolidBits m_solid_bits; // `is_static_solid` of every pixel, kept up to date by `set_particle_id`
     Bitset2D<WIDTH * CHUNK_WIDTH, HEIGHT * CHUNK_HEIGHT> m_updated_particles;
     
-    Bitset2D<WIDTH, HEIGHT> m_dirty_chunks;
+    Array2D<u8, WIDTH, HEIGHT> m_dirty_chunks; // changed since the last capture_mesh_snapshot(), see set_chunk_dirty()
+    Bitset2D<WIDTH, HEIGHT> m_island_dirty; // chunks whose anchoring pixels changed since the last find_islands()
+
+    // snapshot state
+    Array2D<u8, WIDTH, HEIGHT> m_chunk_changed;   // material written since the last publish_snapshot()
+    Array2D<u32, WIDTH, HEIGHT> m_chunk_versions; // bumped by publish_snapshot() for those
+    TripleBuffer<Snapshot> m_snapshots;
+
+    // renderToTexture() state, reader thread only
+    Array2D<u32, WIDTH, HEIGHT> m_uploaded_versions; // of the chunks in the texture
+    std::vector<u32> m_texture_staging;
+
+    // narrows [t0, t1] to where `o + d * t` lies within [0, size]
+    static bool clip_ray(f32 o, f32 d, f32 size, f32& t0, f32& t1) {
+        if (d == 0.0f) {
+            return o >= 0.0f && o < size;
+        }
+        f32 a = -o / d;
+        f32 b = (size - o) / d;
+        if (a > b) {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        return t0 <= t1;
+    }
+
+    // runs `write(x, y, scratch)` on every interior cell of `spans` once, returning whether that cell's anchoring
+    // changed; then marks the covered chunks (and their neighbours) dirty and the changed islands for a re-check
+    // returns how many scratches were used
+    template <typename F>
+    u64 edit_spans(std::span<const Span> spans, F&& write) {
+        // merged, so no two tasks ever share a cell
+        m_edit_spans.assign(spans.begin(), spans.end());
+        clip_spans(m_edit_spans, 1, 1, static_cast<i32>(width()) - 1, static_cast<i32>(height()) - 1);
+        normalize_spans(m_edit_spans);
+        if (m_edit_spans.empty()) {
+            return 0;
+        }
+
+        u64 cells = 0;
+        i32 min_x = INT32_MAX, max_x = INT32_MIN;
+        for (const Span& s : m_edit_spans) {
+            cells += static_cast<u64>(s.x1 - s.x0);
+            min_x = std::min(min_x, s.x0);
+            max_x = std::max(max_x, s.x1 - 1);
+        }
+
+        const u64 count = m_edit_spans.size();
+        const u64 tasks = std::clamp<u64>(cells / PARALLEL_EDIT_CELLS, 1, std::min<u64>(std::max<u64>(m_thread_pool.thread_count(), 1), count));
+        m_edit_scratch.resize(std::max<u64>(m_edit_scratch.size(), tasks));
+
+        const auto edit_rows = [this, &write, count, tasks](u64 t) {
+            EditScratch& scratch = m_edit_scratch[t];
+            scratch.removed.clear();
+            scratch.unanchored.clear();
+            for (u64 i = t * count / tasks; i < (t + 1) * count / tasks; ++i) {
+                const Span& s = m_edit_spans[i];
+                for (i32 x = s.x0; x < s.x1; ++x) {
+                    if (write(x, s.y, scratch)) {
+                        scratch.unanchored.push_back({x, s.y});
+                    }
+                }
+            }
+        };
+        if (tasks == 1) {
+            edit_rows(0);
+        } else {
+            for (u64 t = 0; t < tasks; ++t) {
+                m_thread_pool.enqueue([&edit_rows, t] { edit_rows(t); });
+            }
+            m_thread_pool.wait_all();
+        }
+
+        for (u64 t = 0; t < tasks; ++t) {
+            for (const auto& [x, y] : m_edit_scratch[t].unanchored) {
+                mark_island_dirty(x, y);
+            }
+        }
+
+        // one pixel around the shape, so neighbouring chunks whose particles can now move wake up too
+        const u32 cx0 = static_cast<u32>(min_x - 1) / CHUNK_WIDTH;
+        const u32 cx1 = std::min(static_cast<u32>(max_x + 1) / CHUNK_WIDTH, WIDTH - 1);
+        const u32 cy0 = static_cast<u32>(m_edit_spans.front().y - 1) / CHUNK_HEIGHT;
+        const u32 cy1 = std::min(static_cast<u32>(m_edit_spans.back().y + 1) / CHUNK_HEIGHT, HEIGHT - 1);
+        for (u32 cy = cy0; cy <= cy1; ++cy) {
+            for (u32 cx = cx0; cx <= cx1; ++cx) {
+                set_chunk_dirty(cx, cy);
+            }
+        }
+        return tasks;
+    }
+
+    std::vector<Span> m_query_spans;
+
+    // region edit state, one scratch per task
+    struct EditScratch {
+        std::vector<CarvedCell> removed;
+        std::vector<std::pair<i32, i32>> unanchored;
+    };
+    static constexpr u64 PARALLEL_EDIT_CELLS = 16384; // per task, smaller edits stay on the calling thread
+    std::vector<Span> m_edit_shape;
+    std::vector<Span> m_edit_spans;
+    std::vector<EditScratch> m_edit_scratch;
+
+    // displace_liquid() search, offsets from where it started
+    static constexpr i32 LIQUID_SEARCH_RADIUS = 24;
+    std::vector<bool> m_liquid_visited;
+    std::vector<std::pair<i32, i32>> m_liquid_queue;
 
     ThreadPool m_thread_pool;
 };
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+
+#include "Commons.hpp"
+#include "Logging.hpp"
+
+// Dense storage addressed by generational 16-bit handles
+// Values are packed contiguously (removal swaps the last one in), slots map handles to them.
+// A slot index is reused once freed, its generation tells the new occupant from stale handles.
+template <typename T>
+class SlotMap {
+public:
+    struct Key {
+        u16 index = 0; // never 0 for a key handed out, so 0 can mean "none"
+        u16 generation = 0;
+
+        constexpr bool operator==(const Key&) const = default;
+
+        // round-trips through 32 bits, e.g. a pointer-sized user data field
+        constexpr u32 packed() const { return (static_cast<u32>(generation) << 16) | index; }
+        static constexpr Key unpack(u32 v) { return {static_cast<u16>(v & 0xFFFF), static_cast<u16>(v >> 16)}; }
+    };
+
+    static constexpr u32 CAPACITY = UINT16_MAX; // slot 0 is reserved
+
+    // returns a null key (index 0) when full
+    Key add(const T& value) { return add(T(value)); }
+    Key add(T&& value) {
+        u16 index;
+        if (!m_free.empty()) {
+            index = m_free.back();
+            m_free.pop_back();
+        } else if (m_slots.size() <= CAPACITY) {
+            if (m_slots.empty()) {
+                m_slots.push_back({}); // slot 0
+            }
+            index = static_cast<u16>(m_slots.size());
+            m_slots.push_back({});
+        } else {
+            Logging::log_error("SlotMap is full");
+            return {};
+        }
+
+        Slot& slot = m_slots[index];
+        slot.dense = static_cast<u32>(m_data.size());
+        m_data.push_back(std::move(value));
+        m_keys.push_back({index, slot.generation});
+        return m_keys.back();
+    }
+
+    void remove(Key key) {
+        if (!has(key)) {
+            Logging::log_warning("Trying to remove a stale SlotMap key ", key.index, ':', key.generation);
+            return;
+        }
+
+        Slot& slot = m_slots[key.index];
+        const u32 removed = slot.dense;
+        const u32 last = static_cast<u32>(m_data.size() - 1);
+        if (removed != last) {
+            m_data[removed] = std::move(m_data[last]);
+            m_keys[removed] = m_keys[last];
+            m_slots[m_keys[removed].index].dense = removed;
+        }
+        m_data.pop_back();
+        m_keys.pop_back();
+
+        slot.dense = FREE;
+        ++slot.generation;
+        m_free.push_back(key.index);
+    }
+
+    bool has(Key key) const {
+        return key.index != 0 && key.index < m_slots.size() && m_slots[key.index].dense != FREE &&
+               m_slots[key.index].generation == key.generation;
+    }
+
+    T* get(Key key) { return has(key) ? &m_data[m_slots[key.index].dense] : nullptr; }
+    const T* get(Key key) const { return has(key) ? &m_data[m_slots[key.index].dense] : nullptr; }
+
+    // current occupant of a slot, whatever its generation
+    Key key_at(u16 index) const {
+        if (index == 0 || index >= m_slots.size() || m_slots[index].dense == FREE) {
+            return {};
+        }
+        return m_keys[m_slots[index].dense];
+    }
+
+    // packed values and their keys, in the same order
+    std::vector<T>& all() { return m_data; }
+    const std::vector<T>& all() const { return m_data; }
+    const std::vector<Key>& all_keys() const { return m_keys; }
+
+    u64 size() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+
+    // keeps generations, so keys from before the clear stay stale
+    void clear() {
+        for (const Key& key : m_keys) {
+            m_slots[key.index].dense = FREE;
+            ++m_slots[key.index].generation;
+            m_free.push_back(key.index);
+        }
+        m_data.clear();
+        m_keys.clear();
+    }
+
+private:
+    static constexpr u32 FREE = UINT32_MAX;
+
+    struct Slot {
+        u32 dense = FREE;
+        u16 generation = 0;
+    };
+
+    std::vector<T> m_data;
+    std::vector<Key> m_keys; // key of each packed value
+    std::vector<Slot> m_slots;
+    std::vector<u16> m_free;
+};
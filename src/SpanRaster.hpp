@@ -0,0 +1,147 @@
+#pragma once
+
+#include <box2d/box2d.h>
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+
+#include "Commons.hpp"
+
+// Scanline rasterization into row spans, in pixel coordinates
+// A pixel is covered when its center (x + 0.5, y + 0.5) is inside the shape. Edges are half-open,
+// so shapes sharing an edge never both cover a pixel.
+
+// pixels [x0, x1) of row y
+struct Span {
+    i32 y, x0, x1;
+};
+
+// appends the spans of a convex polygon (any winding), rows in order
+inline void rasterize_convex(std::span<const b2Vec2> vertices, std::vector<Span>& out) {
+    if (vertices.size() < 3) {
+        return;
+    }
+
+    f32 min_y = vertices[0].y;
+    f32 max_y = vertices[0].y;
+    for (const b2Vec2& v : vertices) {
+        min_y = std::min(min_y, v.y);
+        max_y = std::max(max_y, v.y);
+    }
+
+    // rows whose center lies in [min_y, max_y)
+    const i32 y0 = static_cast<i32>(std::ceil(min_y - 0.5f));
+    const i32 y1 = static_cast<i32>(std::ceil(max_y - 0.5f));
+
+    for (i32 y = y0; y < y1; ++y) {
+        const f32 cy = y + 0.5f;
+
+        // a convex polygon crosses a row exactly twice
+        f32 left = INFINITY;
+        f32 right = -INFINITY;
+        for (u64 i = 0; i < vertices.size(); ++i) {
+            const b2Vec2 a = vertices[i];
+            const b2Vec2 b = vertices[(i + 1) % vertices.size()];
+            if ((a.y <= cy) != (b.y <= cy)) {
+                const f32 x = a.x + (cy - a.y) * (b.x - a.x) / (b.y - a.y);
+                left = std::min(left, x);
+                right = std::max(right, x);
+            }
+        }
+
+        const i32 x0 = static_cast<i32>(std::ceil(left - 0.5f));
+        const i32 x1 = static_cast<i32>(std::ceil(right - 0.5f));
+        if (x0 < x1) {
+            out.push_back({y, x0, x1});
+        }
+    }
+}
+
+// keeps the parts of `spans` inside [min_x, max_x) x [min_y, max_y), in place
+inline void clip_spans(std::vector<Span>& spans, i32 min_x, i32 min_y, i32 max_x, i32 max_y) {
+    std::erase_if(spans, [&](Span& s) {
+        s.x0 = std::max(s.x0, min_x);
+        s.x1 = std::min(s.x1, max_x);
+        return s.y < min_y || s.y >= max_y || s.x0 >= s.x1;
+    });
+}
+
+// sorts spans by row then x and merges the ones that overlap or touch, so every pixel is covered at most once
+inline void normalize_spans(std::vector<Span>& spans) {
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.y != b.y ? a.y < b.y : a.x0 < b.x0; });
+
+    u64 n = 0;
+    for (const Span& s : spans) {
+        if (n > 0 && spans[n - 1].y == s.y && spans[n - 1].x1 >= s.x0) {
+            spans[n - 1].x1 = std::max(spans[n - 1].x1, s.x1);
+        } else {
+            spans[n++] = s;
+        }
+    }
+    spans.resize(n);
+}
+
+// appends the pixels of `a` not covered by `b`, both normalized
+inline void subtract_spans(const std::vector<Span>& a, const std::vector<Span>& b, std::vector<Span>& out) {
+    u64 j = 0;
+    for (const Span& s : a) {
+        while (j < b.size() && (b[j].y < s.y || (b[j].y == s.y && b[j].x1 <= s.x0))) {
+            ++j;
+        }
+
+        i32 x = s.x0;
+        for (u64 k = j; k < b.size() && b[k].y == s.y && b[k].x0 < s.x1; ++k) {
+            if (b[k].x0 > x) {
+                out.push_back({s.y, x, b[k].x0});
+            }
+            x = std::max(x, b[k].x1);
+        }
+        if (x < s.x1) {
+            out.push_back({s.y, x, s.x1});
+        }
+    }
+}
+
+// appends the spans of a circle, rows in order
+inline void rasterize_circle(b2Vec2 center, f32 radius, std::vector<Span>& out) {
+    const i32 y0 = static_cast<i32>(std::ceil(center.y - radius - 0.5f));
+    const i32 y1 = static_cast<i32>(std::ceil(center.y + radius - 0.5f));
+    for (i32 y = y0; y < y1; ++y) {
+        const f32 dy = y + 0.5f - center.y;
+        const f32 h2 = radius * radius - dy * dy;
+        if (h2 <= 0.0f) {
+            continue;
+        }
+        const f32 half = std::sqrt(h2);
+        const i32 x0 = static_cast<i32>(std::ceil(center.x - half - 0.5f));
+        const i32 x1 = static_cast<i32>(std::ceil(center.x + half - 0.5f));
+        if (x0 < x1) {
+            out.push_back({y, x0, x1});
+        }
+    }
+}
+
+// appends the spans of the segment a-b thickened by `radius`, rows not merged (normalize_spans them)
+inline void rasterize_capsule(b2Vec2 a, b2Vec2 b, f32 radius, std::vector<Span>& out) {
+    rasterize_circle(a, radius, out);
+    const b2Vec2 d = {b.x - a.x, b.y - a.y};
+    const f32 length = std::sqrt(d.x * d.x + d.y * d.y);
+    if (length == 0.0f) {
+        return;
+    }
+    rasterize_circle(b, radius, out);
+    const b2Vec2 n = {-d.y / length * radius, d.x / length * radius};
+    const b2Vec2 body[4] = {{a.x + n.x, a.y + n.y}, {b.x + n.x, b.y + n.y}, {b.x - n.x, b.y - n.y}, {a.x - n.x, a.y - n.y}};
+    rasterize_convex(body, out);
+}
+
+// appends the spans of the pixels [min_x, max_x) x [min_y, max_y)
+inline void rasterize_rect(i32 min_x, i32 min_y, i32 max_x, i32 max_y, std::vector<Span>& out) {
+    if (min_x >= max_x) {
+        return;
+    }
+    for (i32 y = min_y; y < max_y; ++y) {
+        out.push_back({y, min_x, max_x});
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "Commons.hpp"
+
+// Lock-free mailbox between one writer and one reader, for whole frames of state
+// The writer fills `back()` then publishes it; the reader takes whatever was published last through `front()`.
+// Three buffers mean neither side ever waits: the one in the middle is swapped out atomically by both.
+// A buffer comes back to the writer with whatever it held, so writers can update it incrementally.
+template <typename T>
+class TripleBuffer {
+public:
+    // writer side
+    T& back() { return m_buffers[m_back]; }
+
+    void publish() {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side: the latest published buffer, stays untouched until the next call
+    const T& front() {
+        if (m_middle.load(std::memory_order_relaxed) & FRESH) {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        }
+        return m_buffers[m_front];
+    }
+
+private:
+    static constexpr u8 INDEX = 0x3;
+    static constexpr u8 FRESH = 0x4; // published since the reader last looked
+
+    std::array<T, 3> m_buffers{};
+    u8 m_back = 0;  // writer only
+    u8 m_front = 1; // reader only
+    alignas(64) std::atomic<u8> m_middle{2};
+};